@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new/delete of the executable that includes it (include it from one
+// translation unit only) to count live heap bytes, so memory benchmarks can compare footprints.
+// Each block carries a header with its size; over-aligned requests keep the default operators.
+class AllocCounter {
+public:
+  static size_t live_bytes() { return LiveBytes().load(std::memory_order_relaxed); }
+  static size_t allocations() { return Allocations().load(std::memory_order_relaxed); }
+
+  static std::atomic<size_t>& LiveBytes() {
+    static std::atomic<size_t> bytes{0};
+    return bytes;
+  }
+
+  static std::atomic<size_t>& Allocations() {
+    static std::atomic<size_t> count{0};
+    return count;
+  }
+};
+
+namespace alloc_counter_detail {
+
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+inline void* Allocate(size_t size) {
+  char* block = static_cast<char*>(std::malloc(size + kHeader));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  AllocCounter::LiveBytes().fetch_add(size, std::memory_order_relaxed);
+  AllocCounter::Allocations().fetch_add(1, std::memory_order_relaxed);
+  return block + kHeader;
+}
+
+inline void Deallocate(void* ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  char* block = static_cast<char*>(ptr) - kHeader;
+  AllocCounter::LiveBytes().fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+  std::free(block);
+}
+
+}  // namespace alloc_counter_detail
+
+void* operator new(size_t size) {
+  return alloc_counter_detail::Allocate(size);
+}
+
+void* operator new[](size_t size) {
+  return alloc_counter_detail::Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  alloc_counter_detail::Deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  alloc_counter_detail::Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  alloc_counter_detail::Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  alloc_counter_detail::Deallocate(ptr);
+}
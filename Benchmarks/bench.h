@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Perf/perf_counters.h"
+
+// Small self-contained harness shared by the benchmark executables.
+//
+// Cases are grouped; the first implementation registered in a group (by convention the std
+// equivalent) is the baseline the others are compared against. Each case runs repeat times and
+// reports the best and the median time per operation. Extra figures (bytes, percentiles) are
+// attached with metric(). With --counters every case also gets hardware counter figures per
+// operation, averaged over its repetitions, for the events the machine lets us open.
+//
+// Command line: --json <file>  write results as JSON
+//               --filter <text> only run groups whose name contains text
+//               --repeat <n>    repetitions per case (default 5)
+//               --scale <f>     multiply every operation count, e.g. 0.1 for a smoke run
+//               --counters      add perf_event_open counters to every case
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory() {
+  asm volatile("" : : : "memory");
+}
+
+class Bench {
+public:
+  struct Result {
+    std::string group;
+    std::string impl;
+    size_t ops;
+    double best;
+    double median;
+    std::vector<std::pair<std::string, double>> metrics;
+  };
+
+  // Measures the regions between start() and stop(); a case may time several.
+  class Timer {
+  public:
+    explicit Timer(PerfCounters* counters) : counters_(counters), elapsed_(0) {}
+
+    void start() {
+      if (counters_ != nullptr) {
+        counters_->start();
+      }
+      start_ = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+      ClobberMemory();
+      elapsed_ += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+      if (counters_ != nullptr) {
+        counts_ += counters_->stop();
+      }
+    }
+
+    double elapsed() const { return elapsed_; }
+    const PerfCounters::Sample& counts() const { return counts_; }
+
+  private:
+    PerfCounters* counters_;
+    std::chrono::steady_clock::time_point start_;
+    double elapsed_;
+    PerfCounters::Sample counts_;
+  };
+
+  Bench(std::string suite, int argc, char** argv);
+
+  Bench(const Bench& tmp) = delete;
+  Bench& operator=(const Bench& tmp) = delete;
+
+  // Recorded in the JSON header, e.g. the count policy an executable was built with.
+  void config(const std::string& key, const std::string& value) {
+    config_.emplace_back(key, value);
+  }
+
+  bool enabled(const std::string& group) const {
+    return filter_.empty() || group.find(filter_) != std::string::npos;
+  }
+
+  size_t scaled(size_t ops) const {
+    return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(ops) * scale_));
+  }
+
+  // body(ops) performs ops operations; its wall time divided by ops is the figure reported.
+  template <typename Body>
+  void run(const std::string& group, const std::string& impl, size_t ops, Body body);
+
+  // Like run, but body(ops, timer) brackets the work it wants charged with timer.start() and
+  // timer.stop(), for cases with setup that should not count.
+  template <typename Body>
+  void run_timed(const std::string& group, const std::string& impl, size_t ops, Body body);
+
+  // A figure for the last case of group/impl, or a case of its own if there is none yet.
+  void metric(const std::string& group, const std::string& impl, const std::string& key, double value);
+
+  // Prints the table, writes JSON if asked to, and returns the process exit code.
+  int finish();
+
+private:
+  std::string suite_;
+  std::string json_;
+  std::string filter_;
+  size_t repeat_;
+  double scale_;
+  std::unique_ptr<PerfCounters> counters_;
+  std::vector<std::pair<std::string, std::string>> config_;
+  std::vector<Result> results_;
+
+  Result* Find(const std::string& group, const std::string& impl);
+  void Record(const std::string& group, const std::string& impl, size_t ops, std::vector<double> samples,
+              const PerfCounters::Sample& counts);
+  static std::string Escape(const std::string& text);
+};
+
+inline Bench::Bench(std::string suite, int argc, char** argv) : suite_(std::move(suite)), repeat_(5), scale_(1.0) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--json" && has_value) {
+      json_ = argv[++i];
+    } else if (arg == "--filter" && has_value) {
+      filter_ = argv[++i];
+    } else if (arg == "--repeat" && has_value) {
+      repeat_ = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--scale" && has_value) {
+      scale_ = std::atof(argv[++i]);
+    } else if (arg == "--counters") {
+      counters_ = std::make_unique<PerfCounters>();
+    } else {
+      std::fprintf(stderr, "usage: %s [--json file] [--filter text] [--repeat n] [--scale f] [--counters]\n", argv[0]);
+      std::exit(2);
+    }
+  }
+  if (counters_ != nullptr && !counters_->available()) {
+    std::fprintf(stderr, "hardware counters unavailable (see /proc/sys/kernel/perf_event_paranoid), timing only\n");
+    counters_.reset();
+  }
+  std::string events;
+  for (size_t i = 0; counters_ != nullptr && i < PerfCounters::kEvents; ++i) {
+    if (counters_->available(static_cast<PerfEvent>(i))) {
+      events += (events.empty() ? "" : " ") + std::string(PerfCounters::name(static_cast<PerfEvent>(i)));
+    }
+  }
+  config("counters", events.empty() ? "off" : events);
+#if defined(__clang__)
+  config("compiler", std::string("clang ") + __clang_version__);
+#elif defined(__GNUC__)
+  config("compiler", std::string("gcc ") + __VERSION__);
+#endif
+#ifdef NDEBUG
+  config("assertions", "off");
+#else
+  config("assertions", "on");
+#endif
+}
+
+template <typename Body>
+void Bench::run(const std::string& group, const std::string& impl, size_t ops, Body body) {
+  run_timed(group, impl, ops, [&](size_t count, Timer& timer) {
+    timer.start();
+    body(count);
+    timer.stop();
+  });
+}
+
+template <typename Body>
+void Bench::run_timed(const std::string& group, const std::string& impl, size_t ops, Body body) {
+  if (!enabled(group)) {
+    return;
+  }
+  ops = scaled(ops);
+  std::vector<double> samples;
+  PerfCounters::Sample counts;
+  for (size_t i = 0; i < repeat_; ++i) {
+    Timer timer(counters_.get());
+    body(ops, timer);
+    samples.push_back(timer.elapsed() / static_cast<double>(ops));
+    counts += timer.counts();
+  }
+  Record(group, impl, ops, std::move(samples), counts);
+}
+
+inline Bench::Result* Bench::Find(const std::string& group, const std::string& impl) {
+  for (auto it = results_.rbegin(); it != results_.rend(); ++it) {
+    if (it->group == group && it->impl == impl) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+inline void Bench::Record(const std::string& group, const std::string& impl, size_t ops, std::vector<double> samples,
+                          const PerfCounters::Sample& counts) {
+  std::sort(samples.begin(), samples.end());
+  Result result{group, impl, ops, samples.front(), samples[samples.size() / 2], {}};
+  double total_ops = static_cast<double>(ops * repeat_);
+  for (size_t i = 0; i < PerfCounters::kEvents; ++i) {
+    if (counts.valid[i]) {
+      result.metrics.emplace_back(std::string(PerfCounters::name(static_cast<PerfEvent>(i))) + "_per_op",
+                                  counts.values[i] / total_ops);
+    }
+  }
+  if (counts.has(PerfEvent::Cycles) && counts.has(PerfEvent::Instructions) && counts[PerfEvent::Cycles] > 0) {
+    result.metrics.emplace_back("ipc", counts[PerfEvent::Instructions] / counts[PerfEvent::Cycles]);
+  }
+  results_.push_back(std::move(result));
+}
+
+inline void Bench::metric(const std::string& group, const std::string& impl, const std::string& key, double value) {
+  if (!enabled(group)) {
+    return;
+  }
+  Result* result = Find(group, impl);
+  if (result == nullptr) {
+    results_.push_back(Result{group, impl, 0, 0, 0, {}});
+    result = &results_.back();
+  }
+  result->metrics.emplace_back(key, value);
+}
+
+inline std::string Bench::Escape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += (c == '\n' ? ' ' : c);
+  }
+  return out;
+}
+
+inline int Bench::finish() {
+  std::printf("%-34s %-30s %12s %12s %8s\n", "group", "impl", "best ns/op", "median", "vs base");
+  const Result* base = nullptr;
+  for (const Result& result : results_) {
+    if (base == nullptr || base->group != result.group) {
+      base = &result;
+    }
+    if (result.ops != 0) {
+      double ratio = base->ops != 0 && base->best > 0 ? result.best / base->best : 1.0;
+      std::printf("%-34s %-30s %12.2f %12.2f %7.2fx\n", result.group.c_str(), result.impl.c_str(), result.best,
+                  result.median, ratio);
+    } else {
+      std::printf("%-34s %-30s\n", result.group.c_str(), result.impl.c_str());
+    }
+    for (const auto& [key, value] : result.metrics) {
+      std::printf("%-34s   %-28s %12.2f\n", "", key.c_str(), value);
+    }
+  }
+
+  if (json_.empty()) {
+    return 0;
+  }
+  std::ofstream out(json_);
+  if (!out) {
+    std::fprintf(stderr, "cannot write %s\n", json_.c_str());
+    return 1;
+  }
+  out << "{\n  \"suite\": \"" << Escape(suite_) << "\",\n  \"config\": {";
+  for (size_t i = 0; i < config_.size(); ++i) {
+    out << (i == 0 ? "" : ",") << "\n    \"" << Escape(config_[i].first) << "\": \"" << Escape(config_[i].second) << "\"";
+  }
+  out << "\n  },\n  \"results\": [";
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const Result& result = results_[i];
+    out << (i == 0 ? "" : ",") << "\n    {\"group\": \"" << Escape(result.group) << "\", \"impl\": \""
+        << Escape(result.impl) << "\", \"ops\": " << result.ops << ", \"best_ns_per_op\": " << result.best
+        << ", \"median_ns_per_op\": " << result.median << ", \"metrics\": {";
+    for (size_t j = 0; j < result.metrics.size(); ++j) {
+      out << (j == 0 ? "" : ", ") << "\"" << Escape(result.metrics[j].first) << "\": " << result.metrics[j].second;
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+  return out ? 0 : 1;
+}
@@ -0,0 +1,498 @@
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bench.h"
+#include "alloc_counter.h"
+#include "../List/list.h"
+#include "../Deque/deque.h"
+#include "../UnrolledList/unrolled_list.h"
+#include "../LruCache/lru_cache.h"
+#include "../MpscQueue/mpsc_queue.h"
+#include "../PersistentList/persistent_list.h"
+
+namespace {
+
+constexpr size_t kElements = 100000;
+
+// Deterministic and cheap enough not to show up in the figures.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  size_t below(size_t bound) {
+    return static_cast<size_t>(next() % bound);
+  }
+
+private:
+  uint64_t state_;
+};
+
+template <typename Container>
+void PushBack(size_t ops) {
+  Container c;
+  for (size_t i = 0; i < ops; ++i) {
+    c.push_back(static_cast<int>(i));
+  }
+  DoNotOptimize(c);
+}
+
+template <typename Container>
+void PushFront(size_t ops) {
+  Container c;
+  for (size_t i = 0; i < ops; ++i) {
+    c.push_front(static_cast<int>(i));
+  }
+  DoNotOptimize(c);
+}
+
+// Fill, then empty from both ends, so every push is matched by a pop.
+template <typename Container>
+void PushPop(size_t ops) {
+  Container c;
+  for (size_t i = 0; i < ops / 2; ++i) {
+    c.push_back(static_cast<int>(i));
+  }
+  for (size_t i = 0; i < ops / 2; ++i) {
+    if (i % 2 == 0) {
+      c.pop_back();
+    } else {
+      c.pop_front();
+    }
+  }
+  DoNotOptimize(c);
+}
+
+template <typename Container>
+Container Filled(size_t count) {
+  Container c;
+  for (size_t i = 0; i < count; ++i) {
+    c.push_back(static_cast<int>(i));
+  }
+  return c;
+}
+
+template <typename Container>
+long long Sum(const Container& c) {
+  long long sum = 0;
+  for (const int& value : c) {
+    sum += value;
+  }
+  return sum;
+}
+
+void Sequences(Bench& bench) {
+  bench.run("push_back/list", "std::list", kElements, PushBack<std::list<int>>);
+  bench.run("push_back/list", "List", kElements, PushBack<List<int>>);
+  bench.run("push_back/list", "UnrolledList", kElements, PushBack<UnrolledList<int>>);
+  bench.run("push_back/deque", "std::deque", kElements, PushBack<std::deque<int>>);
+  bench.run("push_back/deque", "Deque", kElements, PushBack<Deque<int>>);
+
+  bench.run("push_front/list", "std::list", kElements, PushFront<std::list<int>>);
+  bench.run("push_front/list", "List", kElements, PushFront<List<int>>);
+  bench.run("push_front/deque", "std::deque", kElements, PushFront<std::deque<int>>);
+  bench.run("push_front/deque", "Deque", kElements, PushFront<Deque<int>>);
+
+  bench.run("push_pop/list", "std::list", kElements, PushPop<std::list<int>>);
+  bench.run("push_pop/list", "List", kElements, PushPop<List<int>>);
+  bench.run("push_pop/deque", "std::deque", kElements, PushPop<std::deque<int>>);
+  bench.run("push_pop/deque", "Deque", kElements, PushPop<Deque<int>>);
+
+  size_t count = bench.scaled(kElements);
+  auto random_access = [&](auto& c) {
+    return [&c, count](size_t ops) {
+      Random random(1);
+      long long sum = 0;
+      for (size_t i = 0; i < ops; ++i) {
+        sum += c[random.below(count)];
+      }
+      DoNotOptimize(sum);
+    };
+  };
+  if (bench.enabled("random_access/deque")) {
+    std::deque<int> std_deque = Filled<std::deque<int>>(count);
+    Deque<int> deque = Filled<Deque<int>>(count);
+    bench.run("random_access/deque", "std::deque", kElements, random_access(std_deque));
+    bench.run("random_access/deque", "Deque", kElements, random_access(deque));
+  }
+
+  auto iterate = [&](auto& c) {
+    return [&c, count](size_t ops) {
+      for (size_t done = 0; done < ops; done += count) {
+        DoNotOptimize(Sum(c));
+      }
+    };
+  };
+  if (bench.enabled("iterate/list")) {
+    std::list<int> std_list = Filled<std::list<int>>(count);
+    List<int> list = Filled<List<int>>(count);
+    UnrolledList<int> unrolled = Filled<UnrolledList<int>>(count);
+    bench.run("iterate/list", "std::list", 10 * kElements, iterate(std_list));
+    bench.run("iterate/list", "List", 10 * kElements, iterate(list));
+    bench.run("iterate/list", "UnrolledList", 10 * kElements, iterate(unrolled));
+  }
+  if (bench.enabled("iterate/deque")) {
+    std::deque<int> std_deque = Filled<std::deque<int>>(count);
+    Deque<int> deque = Filled<Deque<int>>(count);
+    bench.run("iterate/deque", "std::deque", 10 * kElements, iterate(std_deque));
+    bench.run("iterate/deque", "Deque", 10 * kElements, iterate(deque));
+  }
+
+  // Charged per element copied.
+  auto copy = [&](auto& c) {
+    return [&c, count](size_t ops) {
+      for (size_t done = 0; done < ops; done += count) {
+        auto duplicate = c;
+        DoNotOptimize(duplicate);
+      }
+    };
+  };
+  if (bench.enabled("copy/")) {
+    std::list<int> std_list = Filled<std::list<int>>(count);
+    List<int> list = Filled<List<int>>(count);
+    std::deque<int> std_deque = Filled<std::deque<int>>(count);
+    Deque<int> deque = Filled<Deque<int>>(count);
+    bench.run("copy/list", "std::list", 10 * kElements, copy(std_list));
+    bench.run("copy/list", "List", 10 * kElements, copy(list));
+    bench.run("copy/deque", "std::deque", 10 * kElements, copy(std_deque));
+    bench.run("copy/deque", "Deque", 10 * kElements, copy(deque));
+  }
+}
+
+// One op is an insert followed by an erase at the same position in the middle.
+void MiddleEdits(Bench& bench) {
+  auto list_edits = [&](auto make) {
+    return [make, &bench](size_t ops) {
+      auto c = make(bench.scaled(kElements));
+      auto mid = c.begin();
+      std::advance(mid, c.size() / 2);
+      for (size_t i = 0; i < ops; ++i) {
+        mid = c.emplace(mid, static_cast<int>(i));
+        c.erase(mid++);
+      }
+      DoNotOptimize(c);
+    };
+  };
+  bench.run("insert_erase_middle/list", "std::list", kElements, list_edits(Filled<std::list<int>>));
+  bench.run("insert_erase_middle/list", "List", kElements, list_edits(Filled<List<int>>));
+  bench.run("insert_erase_middle/list", "UnrolledList", kElements, [&](size_t ops) {
+    auto c = Filled<UnrolledList<int>>(bench.scaled(kElements));
+    auto mid = c.begin();
+    std::advance(mid, c.size() / 2);
+    for (size_t i = 0; i < ops; ++i) {
+      mid = c.erase(c.emplace(mid, static_cast<int>(i)));
+    }
+    DoNotOptimize(c);
+  });
+
+  // Both deques shift elements, so the container is kept smaller.
+  constexpr size_t kDequeSize = 10000;
+  bench.run("insert_erase_middle/deque", "std::deque", kElements / 10, [](size_t ops) {
+    auto c = Filled<std::deque<int>>(kDequeSize);
+    for (size_t i = 0; i < ops; ++i) {
+      c.insert(c.begin() + kDequeSize / 2, static_cast<int>(i));
+      c.erase(c.begin() + kDequeSize / 2);
+    }
+    DoNotOptimize(c);
+  });
+  bench.run("insert_erase_middle/deque", "Deque", kElements / 10, [](size_t ops) {
+    auto c = Filled<Deque<int>>(kDequeSize);
+    for (size_t i = 0; i < ops; ++i) {
+      c.insert(c.begin() + kDequeSize / 2, static_cast<int>(i));
+      c.erase(c.begin() + kDequeSize / 2);
+    }
+    DoNotOptimize(c);
+  });
+}
+
+// StackAllocator never frees, so each repetition gets a fresh arena; the arena itself is allocated
+// outside the timed region.
+constexpr size_t kArenaBytes = 64 << 20;
+
+template <template <typename, typename> class Container>
+void Allocators(Bench& bench, const std::string& group, const std::string& name) {
+  bench.run(group, name + "<std::allocator>", kElements, [](size_t ops) {
+    Container<int, std::allocator<int>> c;
+    for (size_t i = 0; i < ops; ++i) {
+      c.push_back(static_cast<int>(i));
+    }
+    DoNotOptimize(c);
+  });
+  bench.run_timed(group, name + "<StackAllocator>", kElements, [](size_t ops, Bench::Timer& timer) {
+    auto storage = std::make_unique<StackStorage<kArenaBytes>>();
+    timer.start();
+    {
+      Container<int, StackAllocator<int, kArenaBytes>> c{StackAllocator<int, kArenaBytes>(*storage)};
+      for (size_t i = 0; i < ops; ++i) {
+        c.push_back(static_cast<int>(i));
+      }
+      DoNotOptimize(c);
+    }
+    timer.stop();
+  });
+}
+
+void Sorting(Bench& bench) {
+  size_t count = bench.scaled(kElements);
+  auto shuffled = [count]() {
+    std::vector<int> values(count);
+    Random random(7);
+    for (int& value : values) {
+      value = static_cast<int>(random.next());
+    }
+    return values;
+  };
+  auto sort_list = [&](auto make) {
+    return [make, shuffled](size_t, Bench::Timer& timer) {
+      auto values = shuffled();
+      timer.start();
+      auto c = make(values);
+      c.sort();
+      DoNotOptimize(c);
+      timer.stop();
+    };
+  };
+  auto std_list = [](const std::vector<int>& values) { return std::list<int>(values.begin(), values.end()); };
+  auto list = [](const std::vector<int>& values) {
+    List<int> c;
+    c.assign(values.begin(), values.end());
+    return c;
+  };
+  bench.run_timed("sort", "std::list", kElements, sort_list(std_list));
+  bench.run_timed("sort", "List", kElements, sort_list(list));
+  bench.run_timed("sort", "std::vector", kElements, [shuffled](size_t, Bench::Timer& timer) {
+    auto values = shuffled();
+    timer.start();
+    std::vector<int> c(values.begin(), values.end());
+    std::sort(c.begin(), c.end());
+    DoNotOptimize(c);
+    timer.stop();
+  });
+}
+
+// Nodes are scattered by interleaving two lists and sorting, then traversed before and after
+// compact() puts them back in list order.
+void Compaction(Bench& bench) {
+  if (!bench.enabled("iterate_scattered")) {
+    return;
+  }
+  size_t count = bench.scaled(kElements);
+  List<int> list;
+  List<int> other;
+  Random random(3);
+  for (size_t i = 0; i < count; ++i) {
+    list.push_back(static_cast<int>(random.next()));
+    other.push_back(0);
+  }
+  other.clear();
+  list.sort();
+  auto iterate = [&list, count](size_t ops) {
+    for (size_t done = 0; done < ops; done += count) {
+      DoNotOptimize(Sum(list));
+    }
+  };
+  bench.run("iterate_scattered", "List", 10 * kElements, iterate);
+  list.compact();
+  bench.run("iterate_scattered", "List+compact", 10 * kElements, iterate);
+}
+
+// The usual std LRU: a list in recency order and a map from key to list position.
+class StdLru {
+public:
+  explicit StdLru(size_t capacity) : capacity_(capacity) {}
+
+  int* get(int key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    order_.splice(order_.begin(), order_, it->second);
+    return &it->second->second;
+  }
+
+  void put(int key, int value) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = value;
+      order_.splice(order_.begin(), order_, it->second);
+      return;
+    }
+    order_.emplace_front(key, value);
+    index_[key] = order_.begin();
+    if (order_.size() > capacity_) {
+      index_.erase(order_.back().first);
+      order_.pop_back();
+    }
+  }
+
+private:
+  size_t capacity_;
+  std::list<std::pair<int, int>> order_;
+  std::unordered_map<int, std::list<std::pair<int, int>>::iterator> index_;
+};
+
+void Caches(Bench& bench) {
+  constexpr size_t kCapacity = 10000;
+  auto hits = [](auto make) {
+    return [make](size_t ops, Bench::Timer& timer) {
+      auto cache = make();
+      for (size_t i = 0; i < kCapacity; ++i) {
+        cache.put(static_cast<int>(i), static_cast<int>(i));
+      }
+      Random random(5);
+      timer.start();
+      long long sum = 0;
+      for (size_t i = 0; i < ops; ++i) {
+        sum += *cache.get(static_cast<int>(random.below(kCapacity)));
+      }
+      DoNotOptimize(sum);
+      timer.stop();
+    };
+  };
+  // Every put misses and evicts the least recently used entry.
+  auto misses = [](auto make) {
+    return [make](size_t ops) {
+      auto cache = make();
+      for (size_t i = 0; i < ops; ++i) {
+        cache.put(static_cast<int>(i), static_cast<int>(i));
+      }
+      DoNotOptimize(cache);
+    };
+  };
+  auto std_lru = []() { return StdLru(kCapacity); };
+  auto lru = []() { return LruCache<int, int>(kCapacity); };
+  bench.run_timed("lru_hit", "std::list+unordered_map", kElements, hits(std_lru));
+  bench.run_timed("lru_hit", "LruCache", kElements, hits(lru));
+  bench.run("lru_miss", "std::list+unordered_map", kElements, misses(std_lru));
+  bench.run("lru_miss", "LruCache", kElements, misses(lru));
+}
+
+// Producers push concurrently while one consumer drains; charged per item.
+void Queues(Bench& bench) {
+  constexpr size_t kProducers = 4;
+  bench.run("mpsc", "mutex+List", kElements, [](size_t ops) {
+    std::mutex mutex;
+    List<int> queue;
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&, p] {
+        for (size_t i = p; i < ops; i += kProducers) {
+          std::lock_guard<std::mutex> lock(mutex);
+          queue.push_back(static_cast<int>(i));
+        }
+      });
+    }
+    size_t consumed = 0;
+    List<int> batch;
+    while (consumed < ops) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(queue);
+      }
+      consumed += batch.size();
+      batch.clear();
+    }
+    for (std::thread& producer : producers) {
+      producer.join();
+    }
+  });
+  bench.run("mpsc", "MpscQueue", kElements, [](size_t ops) {
+    MpscQueue<int> queue;
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&, p] {
+        for (size_t i = p; i < ops; i += kProducers) {
+          queue.push(static_cast<int>(i));
+        }
+      });
+    }
+    size_t consumed = 0;
+    List<int> batch;
+    while (consumed < ops) {
+      consumed += queue.drain(batch);
+      batch.clear();
+    }
+    for (std::thread& producer : producers) {
+      producer.join();
+    }
+  });
+}
+
+// Versions that each add one element to a shared base: a persistent list shares the base, a
+// std::list has to copy it. Charged per version.
+void Versions(Bench& bench) {
+  constexpr size_t kBase = 1000;
+  constexpr size_t kVersions = 1000;
+  if (!bench.enabled("versions")) {
+    return;
+  }
+  auto measure = [&](const std::string& impl, auto build) {
+    size_t before = AllocCounter::live_bytes();
+    {
+      auto versions = build();
+      bench.metric("versions", impl, "bytes_per_version",
+                   static_cast<double>(AllocCounter::live_bytes() - before) / kVersions);
+    }
+  };
+  std::list<int> std_base(kBase, 1);
+  PersistentList<int> base;
+  for (size_t i = 0; i < kBase; ++i) {
+    base = base.push_front(1);
+  }
+  bench.run("versions", "std::list", kVersions, [&](size_t ops) {
+    std::vector<std::list<int>> versions;
+    for (size_t i = 0; i < ops; ++i) {
+      versions.push_back(std_base);
+      versions.back().push_front(static_cast<int>(i));
+    }
+    DoNotOptimize(versions);
+  });
+  measure("std::list", [&] {
+    std::vector<std::list<int>> versions;
+    for (size_t i = 0; i < kVersions; ++i) {
+      versions.push_back(std_base);
+      versions.back().push_front(static_cast<int>(i));
+    }
+    return versions;
+  });
+  bench.run("versions", "PersistentList", kVersions, [&](size_t ops) {
+    std::vector<PersistentList<int>> versions;
+    for (size_t i = 0; i < ops; ++i) {
+      versions.push_back(base.push_front(static_cast<int>(i)));
+    }
+    DoNotOptimize(versions);
+  });
+  measure("PersistentList", [&] {
+    std::vector<PersistentList<int>> versions;
+    for (size_t i = 0; i < kVersions; ++i) {
+      versions.push_back(base.push_front(static_cast<int>(i)));
+    }
+    return versions;
+  });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Bench bench("containers", argc, argv);
+  Sequences(bench);
+  MiddleEdits(bench);
+  Allocators<std::list>(bench, "allocator/list", "std::list");
+  Allocators<List>(bench, "allocator/list", "List");
+  Sorting(bench);
+  Compaction(bench);
+  Caches(bench);
+  Queues(bench);
+  Versions(bench);
+  return bench.finish();
+}
@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bench.h"
+#include "alloc_counter.h"
+#include "../SharedPtr/shared_ptr.h"
+#include "../SharedPtr/atomic_shared_ptr.h"
+#include "../SharedPtr/compact_shared_ptr.h"
+#include "../SharedPtr/epoch_domain.h"
+#include "../SharedPtr/intrusive_ptr.h"
+#include "../SharedPtr/object_pool.h"
+#include "../InternCache/intern_cache.h"
+
+// Built once per count policy (see Benchmarks/CMakeLists.txt); group names are the same in every
+// build, so the JSON files line up for policy comparisons.
+namespace {
+
+constexpr size_t kOps = 1000000;
+constexpr size_t kThreads = 4;
+
+struct Payload {
+  long long value;
+
+  explicit Payload(long long value = 0) : value(value) {}
+};
+
+struct IntrusivePayload : public RefCounted<IntrusivePayload> {
+  long long value;
+
+  explicit IntrusivePayload(long long value = 0) : value(value) {}
+};
+
+const char* PolicyName() {
+#if defined(SHARED_PTR_SINGLE_THREADED)
+  return "single-threaded";
+#elif defined(SHARED_PTR_BIASED_COUNT)
+  return "biased";
+#else
+  return "atomic";
+#endif
+}
+
+// Splits ops between kThreads threads running body(thread, count).
+template <typename Body>
+void RunThreads(size_t ops, Body body) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back(body, t, ops / kThreads);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+void Lifecycle(Bench& bench) {
+  bench.run("make", "std::make_shared", kOps, [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(std::make_shared<Payload>(static_cast<long long>(i)));
+    }
+  });
+  bench.run("make", "makeShared", kOps, [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(makeShared<Payload>(static_cast<long long>(i)));
+    }
+  });
+
+  bench.run("adopt_release", "std::shared_ptr", kOps, [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(std::shared_ptr<Payload>(new Payload(static_cast<long long>(i))));
+    }
+  });
+  bench.run("adopt_release", "SharedPtr", kOps, [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(SharedPtr<Payload>(new Payload(static_cast<long long>(i))));
+    }
+  });
+
+  // Copies of a working set of handles, each destroyed right away.
+  constexpr size_t kHandles = 1024;
+  auto copies = [](auto make) {
+    return [make](size_t ops, Bench::Timer& timer) {
+      std::vector<decltype(make(0))> handles;
+      for (size_t i = 0; i < kHandles; ++i) {
+        handles.push_back(make(static_cast<long long>(i)));
+      }
+      timer.start();
+      for (size_t i = 0; i < ops; ++i) {
+        auto copy = handles[i % kHandles];
+        DoNotOptimize(copy);
+      }
+      timer.stop();
+    };
+  };
+  bench.run_timed("copy", "std::shared_ptr", kOps, copies([](long long v) { return std::make_shared<Payload>(v); }));
+  bench.run_timed("copy", "SharedPtr", kOps, copies([](long long v) { return makeShared<Payload>(v); }));
+
+  // Last owners going away: object and block are freed.
+  auto destroy = [](auto make) {
+    return [make](size_t ops, Bench::Timer& timer) {
+      std::vector<decltype(make(0))> handles;
+      for (size_t i = 0; i < ops; ++i) {
+        handles.push_back(make(static_cast<long long>(i)));
+      }
+      timer.start();
+      handles.clear();
+      timer.stop();
+    };
+  };
+  bench.run_timed("destroy", "std::shared_ptr", kOps, destroy([](long long v) { return std::make_shared<Payload>(v); }));
+  bench.run_timed("destroy", "SharedPtr", kOps, destroy([](long long v) { return makeShared<Payload>(v); }));
+
+  bench.run("weak_lock", "std::weak_ptr", kOps, [](size_t ops) {
+    auto owner = std::make_shared<Payload>(1);
+    std::weak_ptr<Payload> weak(owner);
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(weak.lock());
+    }
+  });
+  bench.run("weak_lock", "WeakPtr", kOps, [](size_t ops) {
+    auto owner = makeShared<Payload>(1);
+    WeakPtr<Payload> weak(owner);
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(weak.lock());
+    }
+  });
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+// Every thread copies the same handle, so all of them write one counter.
+void Contention(Bench& bench) {
+  auto shared = [](auto owner) {
+    return [owner](size_t ops) {
+      RunThreads(ops, [&owner](size_t, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+          auto copy = owner;
+          DoNotOptimize(copy);
+        }
+      });
+    };
+  };
+  bench.run("contended_copy", "std::shared_ptr", kOps, shared(std::make_shared<Payload>(1)));
+  bench.run("contended_copy", "SharedPtr", kOps, shared(makeShared<Payload>(1)));
+
+  // Each thread copies handles to objects it made itself: the case biased counting is built for.
+  auto owned = [](auto make) {
+    return [make](size_t ops) {
+      RunThreads(ops, [&make](size_t, size_t count) {
+        auto owner = make();
+        for (size_t i = 0; i < count; ++i) {
+          auto copy = owner;
+          DoNotOptimize(copy);
+        }
+      });
+    };
+  };
+  bench.run("thread_local_copy", "std::shared_ptr", kOps, owned([] { return std::make_shared<Payload>(1); }));
+  bench.run("thread_local_copy", "SharedPtr", kOps, owned([] { return makeShared<Payload>(1); }));
+}
+
+// kThreads readers, one writer replacing the value in a loop; charged per read.
+template <typename Read, typename Write>
+void ReadMostly(size_t ops, Bench::Timer& timer, Read read, Write write) {
+  std::atomic<bool> done{false};
+  timer.start();
+  std::thread writer([&] {
+    for (long long i = 0; !done.load(std::memory_order_relaxed); ++i) {
+      write(i);
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+  });
+  RunThreads(ops, [&read](size_t, size_t count) {
+    long long sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      sum += read();
+    }
+    DoNotOptimize(sum);
+  });
+  timer.stop();
+  done.store(true);
+  writer.join();
+}
+
+void Publication(Bench& bench) {
+  bench.run_timed("read_mostly", "mutex+std::shared_ptr", kOps, [](size_t ops, Bench::Timer& timer) {
+    std::mutex mutex;
+    std::shared_ptr<Payload> current = std::make_shared<Payload>(0);
+    auto read = [&] {
+      std::shared_ptr<Payload> local;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        local = current;
+      }
+      return local->value;
+    };
+    auto write = [&](long long value) {
+      auto fresh = std::make_shared<Payload>(value);
+      std::lock_guard<std::mutex> lock(mutex);
+      current.swap(fresh);
+    };
+    ReadMostly(ops, timer, read, write);
+  });
+#ifdef __cpp_lib_atomic_shared_ptr
+  bench.run_timed("read_mostly", "std::atomic<std::shared_ptr>", kOps, [](size_t ops, Bench::Timer& timer) {
+    std::atomic<std::shared_ptr<Payload>> current(std::make_shared<Payload>(0));
+    auto read = [&] { return current.load()->value; };
+    auto write = [&](long long value) { current.store(std::make_shared<Payload>(value)); };
+    ReadMostly(ops, timer, read, write);
+  });
+#endif
+  bench.run_timed("read_mostly", "AtomicSharedPtr", kOps, [](size_t ops, Bench::Timer& timer) {
+    AtomicSharedPtr<Payload> current(makeShared<Payload>(0));
+    auto read = [&] { return current.load()->value; };
+    auto write = [&](long long value) { current.store(makeShared<Payload>(value)); };
+    ReadMostly(ops, timer, read, write);
+  });
+  // Readers take no reference at all; replaced values are retired to the epoch domain.
+  bench.run_timed("read_mostly", "EpochDomain", kOps, [](size_t ops, Bench::Timer& timer) {
+    std::atomic<Payload*> current(new Payload(0));
+    auto read = [&] {
+      EpochDomain::Guard guard;
+      return current.load(std::memory_order_acquire)->value;
+    };
+    auto write = [&](long long value) {
+      EpochDomain::retire(current.exchange(new Payload(value), std::memory_order_acq_rel));
+    };
+    ReadMostly(ops, timer, read, write);
+    delete current.load();
+    EpochDomain::collect();
+  });
+}
+#endif
+
+struct TreeNode {
+  SharedPtr<TreeNode> left;
+  SharedPtr<TreeNode> right;
+};
+
+SharedPtr<TreeNode> Tree(size_t depth) {
+  auto node = makeShared<TreeNode>();
+  if (depth > 0) {
+    node->left = Tree(depth - 1);
+    node->right = Tree(depth - 1);
+  }
+  return node;
+}
+
+// A request loop that every so often drops a large graph. Immediate release puts the whole teardown
+// into that one request; with DeferredReclaimer each request drains a bounded slice.
+void RequestLatency(Bench& bench) {
+  constexpr size_t kRequests = 5000;
+  constexpr size_t kDropEvery = 100;
+  constexpr size_t kTreeDepth = 13;
+  constexpr size_t kBudget = 256;
+  if (!bench.enabled("request_latency")) {
+    return;
+  }
+  std::vector<double> latencies;
+  auto loop = [&](bool deferred) {
+    return [&, deferred](size_t ops, Bench::Timer& timer) {
+      std::vector<SharedPtr<TreeNode>> graphs;
+      for (size_t i = 0; i < ops; i += kDropEvery) {
+        graphs.push_back(Tree(kTreeDepth));
+      }
+      latencies.clear();
+      latencies.reserve(ops);
+      {
+        std::unique_ptr<DeferredReclaimer::Scope> scope;
+        if (deferred) {
+          scope = std::make_unique<DeferredReclaimer::Scope>();
+        }
+        timer.start();
+        for (size_t i = 0; i < ops; ++i) {
+          auto start = std::chrono::steady_clock::now();
+          DoNotOptimize(makeShared<Payload>(static_cast<long long>(i)));
+          if (i % kDropEvery == 0) {
+            graphs[i / kDropEvery] = SharedPtr<TreeNode>();
+          }
+          if (deferred) {
+            DeferredReclaimer::drain(kBudget);
+          }
+          latencies.push_back(
+              std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        }
+        timer.stop();
+      }
+      DeferredReclaimer::drain();
+    };
+  };
+  auto report = [&](const std::string& impl) {
+    std::sort(latencies.begin(), latencies.end());
+    bench.metric("request_latency", impl, "p50_ns", latencies[latencies.size() / 2]);
+    bench.metric("request_latency", impl, "p99_ns", latencies[latencies.size() * 99 / 100]);
+    bench.metric("request_latency", impl, "max_ns", latencies.back());
+  };
+  bench.run_timed("request_latency", "immediate", kRequests, loop(false));
+  report("immediate");
+  bench.run_timed("request_latency", "DeferredReclaimer", kRequests, loop(true));
+  report("DeferredReclaimer");
+}
+
+// Handle vectors: copying them (one increment per element), summing through them, and the heap each
+// needs per object.
+void Handles(Bench& bench) {
+  constexpr size_t kCount = 100000;
+  size_t count = bench.scaled(kCount);
+  auto measure = [&](const std::string& impl, auto make) {
+    if (!bench.enabled("handles/")) {
+      return;
+    }
+    size_t before = AllocCounter::live_bytes();
+    auto handles = make(count);
+    double bytes = static_cast<double>(AllocCounter::live_bytes() - before) / static_cast<double>(count);
+    bench.run("handles/copy", impl, 10 * kCount, [&](size_t ops) {
+      for (size_t done = 0; done < ops; done += count) {
+        auto copy = handles;
+        DoNotOptimize(copy);
+      }
+    });
+    bench.run("handles/iterate", impl, 10 * kCount, [&](size_t ops) {
+      for (size_t done = 0; done < ops; done += count) {
+        long long sum = 0;
+        for (const auto& handle : handles) {
+          sum += handle->value;
+        }
+        DoNotOptimize(sum);
+      }
+    });
+    bench.metric("handles/copy", impl, "bytes_per_object", bytes);
+  };
+  auto fill = [](auto make) {
+    return [make](size_t n) {
+      std::vector<decltype(make(0))> handles;
+      handles.reserve(n);
+      for (size_t i = 0; i < n; ++i) {
+        handles.push_back(make(static_cast<long long>(i)));
+      }
+      return handles;
+    };
+  };
+  measure("std::shared_ptr", fill([](long long v) { return std::make_shared<Payload>(v); }));
+  measure("SharedPtr", fill([](long long v) { return makeShared<Payload>(v); }));
+  measure("CompactSharedPtr", fill([](long long v) { return makeCompact<Payload>(v); }));
+  measure("IntrusivePtr", fill([](long long v) { return makeIntrusive<IntrusivePayload>(v); }));
+}
+
+struct Buffer {
+  char data[4096];
+};
+
+void Pooling(Bench& bench) {
+  auto allocations = [&](const std::string& impl, auto body) {
+    size_t before = AllocCounter::allocations();
+    body(bench.scaled(kOps));
+    bench.metric("acquire_release", impl, "allocations_per_op",
+                 static_cast<double>(AllocCounter::allocations() - before) / static_cast<double>(bench.scaled(kOps)));
+  };
+  auto std_make = [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(std::make_shared<Buffer>());
+    }
+  };
+  auto make = [](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(makeShared<Buffer>());
+    }
+  };
+  ObjectPool<Buffer> pool(64);
+  auto pooled = [&pool](size_t ops) {
+    for (size_t i = 0; i < ops; ++i) {
+      DoNotOptimize(pool.acquire());
+    }
+  };
+  if (!bench.enabled("acquire_release")) {
+    return;
+  }
+  bench.run("acquire_release", "std::make_shared", kOps, std_make);
+  allocations("std::make_shared", std_make);
+  bench.run("acquire_release", "makeShared", kOps, make);
+  allocations("makeShared", make);
+  bench.run("acquire_release", "ObjectPool", kOps, pooled);
+  allocations("ObjectPool", pooled);
+}
+
+// The strong cache keeps every value it ever built; the intern cache lets values go with their
+// last holder.
+class StrongCache {
+public:
+  SharedPtr<const std::string> intern(const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      it = map_.emplace(key, makeShared<std::string>(value)).first;
+    }
+    return it->second;
+  }
+
+private:
+  std::mutex mutex_;
+  std::unordered_map<std::string, SharedPtr<const std::string>> map_;
+};
+
+void Interning(Bench& bench) {
+  constexpr size_t kKeys = 100000;
+  constexpr size_t kKeep = kKeys / 10;
+  if (!bench.enabled("intern")) {
+    return;
+  }
+  size_t keys_count = bench.scaled(kKeys);
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < keys_count; ++i) {
+    keys.push_back("key-" + std::to_string(i));
+  }
+  const std::string value(64, 'v');
+
+  // Everything interned once, a tenth kept alive, then lookups of the kept keys.
+  auto run = [&](const std::string& impl, auto& cache) {
+    size_t before = AllocCounter::live_bytes();
+    std::vector<SharedPtr<const std::string>> kept;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto interned = cache.intern(keys[i], value);
+      if (i % (kKeys / kKeep) == 0) {
+        kept.push_back(std::move(interned));
+      }
+    }
+    bench.run("intern_hit", impl, kOps, [&](size_t ops) {
+      for (size_t i = 0; i < ops; ++i) {
+        DoNotOptimize(cache.intern(keys[(i % kept.size()) * (kKeys / kKeep)], value));
+      }
+    });
+    bench.metric("intern_hit", impl, "retained_bytes", static_cast<double>(AllocCounter::live_bytes() - before));
+  };
+  {
+    StrongCache cache;
+    run("strong cache", cache);
+  }
+  {
+    InternCache<std::string, std::string> cache;
+    run("InternCache", cache);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Bench bench("shared_ptr", argc, argv);
+  bench.config("count_policy", PolicyName());
+#ifdef SHARED_PTR_32BIT_COUNTS
+  bench.config("count_width", "32");
+#else
+  bench.config("count_width", "64");
+#endif
+  bench.config("tracked_blocks", ControlBlockRegistry::kEnabled ? "on" : "off");
+  Lifecycle(bench);
+#ifndef SHARED_PTR_SINGLE_THREADED
+  Contention(bench);
+  Publication(bench);
+#endif
+  RequestLatency(bench);
+  Handles(bench);
+  Pooling(bench);
+  Interning(bench);
+  return bench.finish();
+}
@@ -165,6 +165,9 @@ public:
     for (auto it = begin_; it != end_; ++it) {
       it.it_->~T();
     }
+    for (size_t i = 0; i < all_chunks_; ++i) {
+      delete[] reinterpret_cast<char*>(out_array_[i]);
+    }
     delete[] out_array_;
   }
 	
@@ -340,11 +343,14 @@ Deque<T>::Deque(const Deque& tmp) : all_chunks_(tmp.all_chunks_) {
 
 template<typename T>
 typename Deque<T>::Deque<T>& Deque<T>::operator=(const Deque& tmp) {
-  if (*this == &tmp) {
+  if (this == &tmp) {
     return *this;
   }
-  all_chunks_ = tmp.all_chunks_;
-  InitFromAnother(tmp);
+  Deque copy(tmp);
+  std::swap(all_chunks_, copy.all_chunks_);
+  std::swap(begin_, copy.begin_);
+  std::swap(end_, copy.end_);
+  std::swap(out_array_, copy.out_array_);
   return *this;
 }
 
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../LruCache/hash_mix.h"
+#include "../SharedPtr/shared_ptr.h"
+
+// Deduplicates immutable values by key while holding them only weakly: a value lives as long as some
+// caller holds the SharedPtr<const V> it got, and the next intern() of its key after that builds a
+// new one. Key and value share one makeShared block and the table keeps a WeakPtr to it, so an entry
+// costs a single allocation and the returned pointer aliases the value inside it.
+//
+// Dead entries are swept a few slots at a time on every call, and whenever a probe runs into one, so
+// there is never a pass over the whole table beyond an ordinary rehash, which drops them too. Until
+// an entry is swept its block (with the storage of the destroyed value) stays allocated.
+template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class InternCache {
+private:
+  struct Interned {
+    K key;
+    V value;
+
+    template <typename... Args>
+    Interned(const K& key, Args&&... args) : key(key), value(std::forward<Args>(args)...) {}
+  };
+
+  struct Slot {
+    WeakPtr<const Interned> entry;
+    size_t hash = 0;
+    bool used = false;
+  };
+
+  static constexpr size_t kSweepStep = 2;
+  static constexpr size_t kMinSlots = 16;
+
+  class Shard {
+  public:
+    std::mutex mutex;
+
+    Shard() : slots_(kMinSlots), count_(0), cursor_(0) {}
+
+    SharedPtr<const V> Find(const K& key, size_t hash, const KeyEqual& equal);
+
+    template <typename... Args>
+    SharedPtr<const V> Intern(const K& key, size_t hash, const KeyEqual& equal, Args&&... args);
+
+    size_t size() const {
+      return count_;
+    }
+
+  private:
+    std::vector<Slot> slots_;
+    size_t count_;
+    size_t cursor_;
+
+    void Place(Slot&& slot);
+    void EraseSlot(size_t index);
+    void Rehash();
+    void Sweep();
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  Hash hash_;
+  KeyEqual equal_;
+
+  Shard& ShardOf(size_t hash) {
+    return *shards_[ShardIndex(hash, shards_.size())];
+  }
+
+public:
+  explicit InternCache(size_t shards = 16);
+
+  InternCache(const InternCache& tmp) = delete;
+  InternCache& operator=(const InternCache& tmp) = delete;
+
+  // The live value for key, or one built from args if there is none.
+  template <typename... Args>
+  SharedPtr<const V> intern(const K& key, Args&&... args);
+
+  // The live value for key, or an empty pointer.
+  SharedPtr<const V> find(const K& key);
+
+  // Entries still in the table, including dead ones not yet swept.
+  size_t size();
+};
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+InternCache<K, V, Hash, KeyEqual>::InternCache(size_t shards) {
+  assert(shards > 0);
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>());
+  }
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+template<typename... Args>
+SharedPtr<const V> InternCache<K, V, Hash, KeyEqual>::intern(const K& key, Args&&... args) {
+  size_t hash = MixHash(hash_(key));
+  Shard& shard = ShardOf(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.Intern(key, hash, equal_, std::forward<Args>(args)...);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+SharedPtr<const V> InternCache<K, V, Hash, KeyEqual>::find(const K& key) {
+  size_t hash = MixHash(hash_(key));
+  Shard& shard = ShardOf(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.Find(key, hash, equal_);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+size_t InternCache<K, V, Hash, KeyEqual>::size() {
+  size_t total = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total += shard->size();
+  }
+  return total;
+}
+
+// Dead entries met on the probe path are erased on the spot; the backward shift may pull the next
+// candidate into the same index, so it is looked at again.
+template<typename K, typename V, typename Hash, typename KeyEqual>
+SharedPtr<const V> InternCache<K, V, Hash, KeyEqual>::Shard::Find(const K& key, size_t hash, const KeyEqual& equal) {
+  Sweep();
+  size_t mask = slots_.size() - 1;
+  size_t i = hash & mask;
+  while (slots_[i].used) {
+    if (slots_[i].entry.expired()) {
+      EraseSlot(i);
+      continue;
+    }
+    if (slots_[i].hash == hash) {
+      SharedPtr<const Interned> live = slots_[i].entry.lock();
+      if (live.get() == nullptr) {
+        EraseSlot(i);
+        continue;
+      }
+      if (equal(live->key, key)) {
+        const V* value = &live->value;
+        return SharedPtr<const V>(std::move(live), value);
+      }
+    }
+    i = (i + 1) & mask;
+  }
+  return SharedPtr<const V>();
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+template<typename... Args>
+SharedPtr<const V> InternCache<K, V, Hash, KeyEqual>::Shard::Intern(const K& key, size_t hash, const KeyEqual& equal,
+                                                                     Args&&... args) {
+  SharedPtr<const V> found = Find(key, hash, equal);
+  if (found.get() != nullptr) {
+    return found;
+  }
+  if (2 * (count_ + 1) > slots_.size()) {
+    Rehash();
+  }
+  SharedPtr<const Interned> entry = makeShared<Interned>(key, std::forward<Args>(args)...);
+  Place(Slot{WeakPtr<const Interned>(entry), hash, true});
+  ++count_;
+  const V* value = &entry->value;
+  return SharedPtr<const V>(std::move(entry), value);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+void InternCache<K, V, Hash, KeyEqual>::Shard::Place(Slot&& slot) {
+  size_t mask = slots_.size() - 1;
+  size_t i = slot.hash & mask;
+  while (slots_[i].used) {
+    i = (i + 1) & mask;
+  }
+  slots_[i] = std::move(slot);
+}
+
+// Linear probing with backward-shift deletion, as in LruCache.
+template<typename K, typename V, typename Hash, typename KeyEqual>
+void InternCache<K, V, Hash, KeyEqual>::Shard::EraseSlot(size_t index) {
+  size_t mask = slots_.size() - 1;
+  for (size_t j = (index + 1) & mask; slots_[j].used; j = (j + 1) & mask) {
+    size_t home = slots_[j].hash & mask;
+    bool stays = (index <= j) ? (index < home && home <= j) : (index < home || home <= j);
+    if (!stays) {
+      slots_[index] = std::move(slots_[j]);
+      index = j;
+    }
+  }
+  slots_[index] = Slot();
+  --count_;
+}
+
+// Dead entries are left behind, so a table full of garbage shrinks back instead of doubling. The new
+// table is at most a quarter full, so rehashes stay amortised however many entries have died.
+template<typename K, typename V, typename Hash, typename KeyEqual>
+void InternCache<K, V, Hash, KeyEqual>::Shard::Rehash() {
+  std::vector<Slot> old_slots;
+  old_slots.swap(slots_);
+  size_t live = 0;
+  for (Slot& slot : old_slots) {
+    live += slot.used && !slot.entry.expired() ? 1 : 0;
+  }
+  size_t size = kMinSlots;
+  while (4 * (live + 1) > size) {
+    size *= 2;
+  }
+  slots_.resize(size);
+  count_ = 0;
+  cursor_ = 0;
+  for (Slot& slot : old_slots) {
+    if (slot.used && !slot.entry.expired()) {
+      Place(std::move(slot));
+      ++count_;
+    }
+  }
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual>
+void InternCache<K, V, Hash, KeyEqual>::Shard::Sweep() {
+  for (size_t step = 0; step < kSweepStep; ++step) {
+    cursor_ = (cursor_ + 1) & (slots_.size() - 1);
+    if (slots_[cursor_].used && slots_[cursor_].entry.expired()) {
+      EraseSlot(cursor_);
+    }
+  }
+}
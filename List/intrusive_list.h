@@ -0,0 +1,333 @@
+#pragma once
+
+#include "list.h"
+
+// Elements derive from a hook; a distinct Tag lets one element carry several hooks and sit in
+// several lists at once. The list gets back from a hook to its element with a static_cast.
+template<bool auto_unlink = false, typename Tag = void>
+struct IntrusiveListHook: public ListBaseNode {
+  static constexpr bool kAutoUnlink = auto_unlink;
+
+  IntrusiveListHook() : ListBaseNode{nullptr, nullptr} {}
+  IntrusiveListHook(const IntrusiveListHook& tmp) : ListBaseNode{nullptr, nullptr} {
+    std::ignore = tmp;
+  }
+
+  IntrusiveListHook& operator=(const IntrusiveListHook& tmp) {
+    std::ignore = tmp;
+    return *this;
+  }
+
+  bool is_linked() const {
+    return next != nullptr;
+  }
+
+  void unlink() {
+    if (is_linked()) {
+      prev->next = next;
+      next->prev = prev;
+      next = nullptr;
+      prev = nullptr;
+    }
+  }
+
+  ~IntrusiveListHook() {
+    if constexpr (auto_unlink) {
+      unlink();
+    }
+  }
+};
+
+template<typename T, typename Tag = void>
+class IntrusiveList {
+private:
+  using BaseNode = ListBaseNode;
+  using Hook = std::conditional_t<std::is_base_of_v<IntrusiveListHook<true, Tag>, T>, IntrusiveListHook<true, Tag>,
+                                  IntrusiveListHook<false, Tag>>;
+
+  static_assert(std::is_base_of_v<Hook, T>, "T must derive from IntrusiveListHook<auto_unlink, Tag>");
+
+  // Auto-unlinked elements leave the ring without telling the list, so size is counted on demand.
+  static constexpr bool kCountSize = !Hook::kAutoUnlink;
+
+  size_t size_;
+  BaseNode fakeNode_;
+
+  static BaseNode* HookOf(T& value) {
+    return static_cast<Hook*>(&value);
+  }
+
+  static T* Owner(BaseNode* node) {
+    return static_cast<T*>(static_cast<Hook*>(node));
+  }
+
+  void Initialization() {
+    fakeNode_.next = &fakeNode_;
+    fakeNode_.prev = &fakeNode_;
+  }
+
+  void StealRing(IntrusiveList& lst) noexcept;
+
+public:
+  template<bool is_const = false>
+  struct common_iterator {
+    using value_type = std::conditional_t<is_const, const T, T>;
+    using pointer = std::conditional_t<is_const, const T*, T*>;
+    using difference_type = int;
+    using reference = std::conditional_t<is_const, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    BaseNode* node;
+
+    common_iterator() = default;
+    common_iterator(BaseNode* tmp) : node(tmp) {}
+    common_iterator(const BaseNode* tmp) : node(const_cast<BaseNode*>(tmp)) {}
+
+    operator common_iterator<true>() const {
+      return common_iterator<true>(node);
+    }
+
+    common_iterator& operator++() {
+      node = node->next;
+      return *this;
+    }
+
+    common_iterator& operator--() {
+      node = node->prev;
+      return *this;
+    }
+
+    common_iterator operator++(int) {
+      common_iterator tmp = *this;
+      node = node->next;
+      return tmp;
+    }
+
+    common_iterator operator--(int) {
+      common_iterator tmp = *this;
+      node = node->prev;
+      return tmp;
+    }
+
+    bool operator==(const common_iterator& tmp) const {
+      return node == tmp.node;
+    }
+
+    bool operator!=(const common_iterator& tmp) const {
+      return node != tmp.node;
+    }
+
+    reference operator*() const {
+      return *Owner(node);
+    }
+
+    pointer operator->() const {
+      return Owner(node);
+    }
+  };
+
+  using iterator = common_iterator<false>;
+  using const_iterator = common_iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  IntrusiveList() : size_(0) {
+    Initialization();
+  }
+
+  IntrusiveList(const IntrusiveList& lst) = delete;
+  IntrusiveList& operator=(const IntrusiveList& lst) = delete;
+
+  IntrusiveList(IntrusiveList&& lst) noexcept : size_(0) {
+    StealRing(lst);
+  }
+
+  IntrusiveList& operator=(IntrusiveList&& lst) noexcept {
+    if (this != &lst) {
+      clear();
+      StealRing(lst);
+    }
+    return *this;
+  }
+
+  iterator begin() {
+    return iterator(fakeNode_.next);
+  }
+
+  iterator end() {
+    return iterator(&fakeNode_);
+  }
+
+  const_iterator cbegin() const {
+    return const_iterator(fakeNode_.next);
+  }
+
+  const_iterator cend() const {
+    return const_iterator(&fakeNode_);
+  }
+
+  const_iterator begin() const {
+    return cbegin();
+  }
+
+  const_iterator end() const {
+    return cend();
+  }
+
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  const_reverse_iterator crbegin() const {
+    return const_reverse_iterator(cend());
+  }
+
+  const_reverse_iterator crend() const {
+    return const_reverse_iterator(cbegin());
+  }
+
+  static iterator iterator_to(T& value) {
+    return iterator(HookOf(value));
+  }
+
+  iterator insert(const_iterator pos, T& value);
+  iterator erase(const_iterator pos);
+  void splice(const_iterator pos, IntrusiveList& lst);
+
+  void push_back(T& value) {
+    insert(end(), value);
+  }
+
+  void push_front(T& value) {
+    insert(begin(), value);
+  }
+
+  void pop_back() {
+    erase(--end());
+  }
+
+  void pop_front() {
+    erase(begin());
+  }
+
+  T& front() {
+    return *begin();
+  }
+
+  T& back() {
+    return *--end();
+  }
+
+  void remove(T& value) {
+    erase(iterator_to(value));
+  }
+
+  bool empty() const {
+    return fakeNode_.next == &fakeNode_;
+  }
+
+  size_t size() const;
+  void clear();
+
+  ~IntrusiveList() {
+    clear();
+  }
+};
+
+template<typename T, typename Tag>
+void IntrusiveList<T, Tag>::StealRing(IntrusiveList& lst) noexcept {
+  if (lst.fakeNode_.next == &lst.fakeNode_) {
+    Initialization();
+  } else {
+    fakeNode_.next = lst.fakeNode_.next;
+    fakeNode_.prev = lst.fakeNode_.prev;
+    fakeNode_.next->prev = &fakeNode_;
+    fakeNode_.prev->next = &fakeNode_;
+  }
+  size_ = lst.size_;
+  lst.Initialization();
+  lst.size_ = 0;
+}
+
+template<typename T, typename Tag>
+typename IntrusiveList<T, Tag>::iterator IntrusiveList<T, Tag>::insert(const_iterator pos, T& value) {
+  BaseNode* node = HookOf(value);
+  assert(node->next == nullptr);
+  BaseNode* after = pos.node;
+  BaseNode* before = after->prev;
+
+  before->next = node;
+  after->prev = node;
+  node->next = after;
+  node->prev = before;
+  if constexpr (kCountSize) {
+    ++size_;
+  }
+  return iterator(node);
+}
+
+template<typename T, typename Tag>
+typename IntrusiveList<T, Tag>::iterator IntrusiveList<T, Tag>::erase(const_iterator pos) {
+  BaseNode* after = pos.node->next;
+  static_cast<Hook*>(pos.node)->unlink();
+  if constexpr (kCountSize) {
+    --size_;
+  }
+  return iterator(after);
+}
+
+template<typename T, typename Tag>
+void IntrusiveList<T, Tag>::splice(const_iterator pos, IntrusiveList& lst) {
+  if (this == &lst || lst.empty()) {
+    return;
+  }
+  BaseNode* first = lst.fakeNode_.next;
+  BaseNode* last = lst.fakeNode_.prev;
+  BaseNode* after = pos.node;
+  BaseNode* before = after->prev;
+
+  before->next = first;
+  first->prev = before;
+  last->next = after;
+  after->prev = last;
+  size_ += lst.size_;
+  lst.Initialization();
+  lst.size_ = 0;
+}
+
+template<typename T, typename Tag>
+size_t IntrusiveList<T, Tag>::size() const {
+  if constexpr (kCountSize) {
+    return size_;
+  }
+  size_t count = 0;
+  for (const BaseNode* node = fakeNode_.next; node != &fakeNode_; node = node->next) {
+    ++count;
+  }
+  return count;
+}
+
+template<typename T, typename Tag>
+void IntrusiveList<T, Tag>::clear() {
+  BaseNode* node = fakeNode_.next;
+  while (node != &fakeNode_) {
+    BaseNode* next = node->next;
+    node->next = nullptr;
+    node->prev = nullptr;
+    node = next;
+  }
+  Initialization();
+  size_ = 0;
+}
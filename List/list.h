@@ -1,9 +1,14 @@
+#pragma once
+
 #include <type_traits>
+#include <algorithm>
 #include <numeric>
 #include <cassert>
 #include <iterator>
 #include <tuple>
 #include <memory>
+#include <functional>
+#include <utility>
 
 template<size_t N>
 class StackStorage {
@@ -69,28 +74,83 @@ bool operator!=(const StackAllocator<T, N>& left, const StackAllocator<T, N>& ri
   return left.storage != right.storage;
 }
 
+struct ListBaseNode {
+  ListBaseNode* next;
+  ListBaseNode* prev;
+};
+
 template<typename T, typename Alloc = std::allocator<T>>
 class List {
 private:
-  struct BaseNode {
-    BaseNode* next;
-    BaseNode* prev;
+  template <typename U, typename A>
+  friend class MpscQueue;
+
+  using BaseNode = ListBaseNode;
+
+  // A compaction slab. Nodes keep no pointer to it: every list that may hold nodes of a slab records
+  // it in slabs_, and the slab is freed once no list records it any more.
+  struct Slab {
+    size_t capacity;
+    size_t used;
+    size_t live;
+    size_t lists;
   };
 
   struct Node: public BaseNode {
     T value;
-    Node() = default;
-    Node(const T& tmp) : value(tmp) {}
+
+    template <typename... Args>
+    Node(Args&&... args) : value(std::forward<Args>(args)...) {}
   };
 
   using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
   using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+  using SlabRecordAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slab*>;
+  using SlabRecordAllocTraits = std::allocator_traits<SlabRecordAlloc>;
+  static constexpr size_t kSlabHeaderNodes = (sizeof(Slab) + sizeof(Node) - 1) / sizeof(Node);
+
   NodeAlloc alloc_;
   size_t size_;
   BaseNode fakeNode_;
+  Slab* compactTarget_ = nullptr;
+  BaseNode* compactCursor_ = nullptr;
+  // Sorted by address; empty unless the list was compacted or took nodes from a list that was.
+  Slab** slabs_ = nullptr;
+  size_t slabCount_ = 0;
+  size_t slabSpace_ = 0;
 
   void Initialization(size_t n, const T& value);
   void TypicalInitialization(size_t n);
+
+  template <typename... Args>
+  Node* CreateNode(Args&&... args);
+  void DestroyNode(Node* node);
+  void Link(BaseNode* after, BaseNode* node);
+  void StealRing(List& lst) noexcept;
+
+  static Node* SlabNodes(Slab* slab) {
+    return reinterpret_cast<Node*>(slab) + kSlabHeaderNodes;
+  }
+
+  Slab* FindSlab(BaseNode* node) const;
+  void ReserveSlabs(size_t count);
+  void RecordSlab(Slab* slab);
+  void ForgetSlab(Slab* slab);
+  void DropSlabs();
+  void AdoptSlabs(const List& lst);
+  void FreeSlab(Slab* slab);
+  void StopCompaction();
+
+  static T& Value(BaseNode* node) {
+    return static_cast<Node*>(node)->value;
+  }
+
+  static void Relink(BaseNode* pos, BaseNode* first, BaseNode* last) noexcept;
+  void TransferFrom(List& lst, BaseNode* pos, BaseNode* first, BaseNode* last, size_t count);
+
+  template <typename Compare>
+  static BaseNode* MergeChains(BaseNode*& left, BaseNode*& right, Compare& comp);
+  void Rethread(BaseNode* const* chains, size_t count) noexcept;
 public:
   using AllocTraits = std::allocator_traits<Alloc>;
 
@@ -142,11 +202,11 @@ public:
       return node != tmp.node;
     }
 
-    reference operator*() {
+    reference operator*() const {
       return (static_cast<Node*>(node)->value);
     }
 
-    pointer operator->() {
+    pointer operator->() const {
       return &(static_cast<Node*>(node)->value);
     }
   };
@@ -167,6 +227,7 @@ public:
   List(size_t n, const T& value, Alloc tmp_alloc);
   List(size_t n, Alloc tmp_alloc);
   List(const List<T, Alloc>& lst);
+  List(List<T, Alloc>&& lst) noexcept;
 
   NodeAlloc& get_allocator() {
     return alloc_;
@@ -174,8 +235,22 @@ public:
 
   void insert(const_iterator pos);
   void insert(const_iterator pos, const T& value);
+  void insert(const_iterator pos, T&& value);
   void erase(const_iterator pos);
 
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args);
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    return *emplace(end(), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  T& emplace_front(Args&&... args) {
+    return *emplace(begin(), std::forward<Args>(args)...);
+  }
+
   iterator begin() {
     iterator tmp = end();
     ++tmp;
@@ -236,6 +311,14 @@ public:
     insert(begin(), value);
   }
 
+  void push_back(T&& value) {
+    insert(end(), std::move(value));
+  }
+
+  void push_front(T&& value) {
+    insert(begin(), std::move(value));
+  }
+
   void pop_back() {
     common_iterator tmp = --end();
     erase(tmp);
@@ -249,95 +332,704 @@ public:
     return size_;
   }
 
-  List& operator=(const List<T, Alloc>& lst);
+  bool empty() const {
+    return size_ == 0;
+  }
 
-  ~List() {
+  void clear() {
+    StopCompaction();
     while (fakeNode_.prev != &fakeNode_) {
       pop_back();
     }
+    DropSlabs();
+  }
+
+  void compact() {
+    while (!compact(static_cast<size_t>(-1))) {}
+  }
+
+  bool compact(size_t budget);
+
+  void swap(List<T, Alloc>& lst) noexcept;
+
+  template <typename InputIt, std::enable_if_t<!std::is_integral_v<InputIt>, int> = 0>
+  void assign(InputIt first, InputIt last);
+  void assign(size_t n, const T& value);
+
+  void splice(const_iterator pos, List<T, Alloc>& lst);
+  void splice(const_iterator pos, List<T, Alloc>& lst, const_iterator it);
+  void splice(const_iterator pos, List<T, Alloc>& lst, const_iterator first, const_iterator last);
+
+  void splice(const_iterator pos, List<T, Alloc>&& lst) {
+    splice(pos, lst);
+  }
+
+  void splice(const_iterator pos, List<T, Alloc>&& lst, const_iterator it) {
+    splice(pos, lst, it);
+  }
+
+  void splice(const_iterator pos, List<T, Alloc>&& lst, const_iterator first, const_iterator last) {
+    splice(pos, lst, first, last);
+  }
+
+  template <typename Compare>
+  void merge(List<T, Alloc>& lst, Compare comp);
+
+  template <typename Compare>
+  void merge(List<T, Alloc>&& lst, Compare comp) {
+    merge(lst, comp);
+  }
+
+  void merge(List<T, Alloc>& lst) {
+    merge(lst, std::less<>());
+  }
+
+  void merge(List<T, Alloc>&& lst) {
+    merge(lst, std::less<>());
+  }
+
+  template <typename Compare>
+  void sort(Compare comp);
+
+  void sort() {
+    sort(std::less<>());
+  }
+
+  void reverse() noexcept;
+
+  template <typename BinaryPredicate>
+  size_t unique(BinaryPredicate pred);
+
+  size_t unique() {
+    return unique(std::equal_to<>());
+  }
+
+  template <typename Predicate>
+  size_t remove_if(Predicate pred);
+
+  size_t remove(const T& value);
+
+  List& operator=(const List<T, Alloc>& lst);
+  List& operator=(List<T, Alloc>&& lst) noexcept(NodeAllocTraits::propagate_on_container_move_assignment::value
+                                                 || NodeAllocTraits::is_always_equal::value);
+
+  ~List() {
+    clear();
   }
 };
 
 template<typename T, typename Alloc>
-void List<T, Alloc>::insert(const_iterator pos, const T& value) {
+void swap(List<T, Alloc>& left, List<T, Alloc>& right) noexcept {
+  left.swap(right);
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+typename List<T, Alloc>::Node* List<T, Alloc>::CreateNode(Args&&... args) {
   Node* tmp = NodeAllocTraits::allocate(alloc_, 1);
   try {
-    NodeAllocTraits::construct(alloc_, tmp, value);
+    NodeAllocTraits::construct(alloc_, tmp, std::forward<Args>(args)...);
   } catch (...) {
     NodeAllocTraits::deallocate(alloc_, tmp, 1);
     throw;
   }
+  return tmp;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::DestroyNode(Node* node) {
+  Slab* slab = FindSlab(node);
+  NodeAllocTraits::destroy(alloc_, node);
+  if (slab == nullptr) {
+    NodeAllocTraits::deallocate(alloc_, node, 1);
+    return;
+  }
+  if (--slab->live == 0 && slab != compactTarget_) {
+    ForgetSlab(slab);
+  }
+}
+
+template<typename T, typename Alloc>
+typename List<T, Alloc>::Slab* List<T, Alloc>::FindSlab(BaseNode* node) const {
+  if (slabCount_ == 0) {
+    return nullptr;
+  }
+  std::less<const void*> less;
+  size_t low = 0;
+  size_t high = slabCount_;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (less(node, slabs_[middle])) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  if (low == 0) {
+    return nullptr;
+  }
+  Slab* slab = slabs_[low - 1];
+  return less(node, SlabNodes(slab) + slab->capacity) ? slab : nullptr;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::ReserveSlabs(size_t count) {
+  if (count <= slabSpace_) {
+    return;
+  }
+  SlabRecordAlloc records(alloc_);
+  size_t space = std::max(count, 2 * slabSpace_);
+  Slab** tmp = SlabRecordAllocTraits::allocate(records, space);
+  std::copy(slabs_, slabs_ + slabCount_, tmp);
+  if (slabs_ != nullptr) {
+    SlabRecordAllocTraits::deallocate(records, slabs_, slabSpace_);
+  }
+  slabs_ = tmp;
+  slabSpace_ = space;
+}
+
+// Room for the record must already be reserved.
+template<typename T, typename Alloc>
+void List<T, Alloc>::RecordSlab(Slab* slab) {
+  size_t pos = slabCount_;
+  while (pos > 0 && std::less<const void*>()(slab, slabs_[pos - 1])) {
+    slabs_[pos] = slabs_[pos - 1];
+    --pos;
+  }
+  slabs_[pos] = slab;
+  ++slabCount_;
+  ++slab->lists;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::ForgetSlab(Slab* slab) {
+  Slab** last = std::remove(slabs_, slabs_ + slabCount_, slab);
+  slabCount_ = last - slabs_;
+  if (--slab->lists == 0) {
+    FreeSlab(slab);
+  }
+  if (slabCount_ == 0) {
+    SlabRecordAlloc records(alloc_);
+    SlabRecordAllocTraits::deallocate(records, slabs_, slabSpace_);
+    slabs_ = nullptr;
+    slabSpace_ = 0;
+  }
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::DropSlabs() {
+  while (slabCount_ > 0) {
+    ForgetSlab(slabs_[slabCount_ - 1]);
+  }
+}
+
+// Called before nodes of lst are relinked into this list, so this list records every slab they may
+// come from. Records of slabs that have emptied are dropped on the way. lst must not be compacting.
+template<typename T, typename Alloc>
+void List<T, Alloc>::AdoptSlabs(const List& lst) {
+  if (lst.slabCount_ == 0) {
+    return;
+  }
+  for (size_t i = slabCount_; i > 0; --i) {
+    if (slabs_[i - 1]->live == 0 && slabs_[i - 1] != compactTarget_) {
+      ForgetSlab(slabs_[i - 1]);
+    }
+  }
+  size_t missing = 0;
+  for (size_t i = 0; i < lst.slabCount_; ++i) {
+    missing += (lst.slabs_[i]->live != 0 && FindSlab(SlabNodes(lst.slabs_[i])) == nullptr);
+  }
+  ReserveSlabs(slabCount_ + missing);
+  for (size_t i = 0; i < lst.slabCount_; ++i) {
+    Slab* slab = lst.slabs_[i];
+    if (slab->live != 0 && FindSlab(SlabNodes(slab)) == nullptr) {
+      RecordSlab(slab);
+    }
+  }
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::FreeSlab(Slab* slab) {
+  size_t count = kSlabHeaderNodes + slab->capacity;
+  slab->~Slab();
+  NodeAllocTraits::deallocate(alloc_, reinterpret_cast<Node*>(slab), count);
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::StopCompaction() {
+  Slab* target = compactTarget_;
+  compactTarget_ = nullptr;
+  compactCursor_ = nullptr;
+  if (target != nullptr && target->live == 0) {
+    ForgetSlab(target);
+  }
+}
+
+// Relocates up to budget nodes, in list order, into one contiguous slab. Returns true once the pass is over.
+template<typename T, typename Alloc>
+bool List<T, Alloc>::compact(size_t budget) {
+  if (compactCursor_ == nullptr) {
+    if (size_ == 0) {
+      return true;
+    }
+    ReserveSlabs(slabCount_ + 1);
+    Node* raw = NodeAllocTraits::allocate(alloc_, kSlabHeaderNodes + size_);
+    compactTarget_ = new (static_cast<void*>(raw)) Slab{size_, 0, 0, 0};
+    RecordSlab(compactTarget_);
+    compactCursor_ = fakeNode_.next;
+  }
+
+  Slab* target = compactTarget_;
+  for (; budget > 0 && compactCursor_ != &fakeNode_ && target->used < target->capacity; --budget) {
+    Node* old = static_cast<Node*>(compactCursor_);
+    Node* tmp = SlabNodes(target) + target->used;
+    NodeAllocTraits::construct(alloc_, tmp, std::move_if_noexcept(old->value));
+    ++target->used;
+    ++target->live;
+
+    tmp->prev = old->prev;
+    tmp->next = old->next;
+    tmp->prev->next = tmp;
+    tmp->next->prev = tmp;
+    compactCursor_ = tmp->next;
+    DestroyNode(old);
+  }
+
+  if (compactCursor_ == &fakeNode_ || target->used == target->capacity) {
+    StopCompaction();
+    return true;
+  }
+  return false;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::Link(BaseNode* after, BaseNode* node) {
+  BaseNode* before = after->prev;
+  before->next = node;
+  after->prev = node;
+  node->next = after;
+  node->prev = before;
   ++size_;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::StealRing(List& lst) noexcept {
+  if (lst.fakeNode_.next == &lst.fakeNode_) {
+    fakeNode_.next = &fakeNode_;
+    fakeNode_.prev = &fakeNode_;
+  } else {
+    fakeNode_.next = lst.fakeNode_.next;
+    fakeNode_.prev = lst.fakeNode_.prev;
+    fakeNode_.next->prev = &fakeNode_;
+    fakeNode_.prev->next = &fakeNode_;
+  }
+  size_ = lst.size_;
+  compactTarget_ = lst.compactTarget_;
+  compactCursor_ = lst.compactCursor_;
+  slabs_ = lst.slabs_;
+  slabCount_ = lst.slabCount_;
+  slabSpace_ = lst.slabSpace_;
+  lst.fakeNode_.next = &lst.fakeNode_;
+  lst.fakeNode_.prev = &lst.fakeNode_;
+  lst.size_ = 0;
+  lst.compactTarget_ = nullptr;
+  lst.compactCursor_ = nullptr;
+  lst.slabs_ = nullptr;
+  lst.slabCount_ = 0;
+  lst.slabSpace_ = 0;
+}
 
-  BaseNode* after = pos.node;
-  --pos;
-  BaseNode* before = pos.node;
+template<typename T, typename Alloc>
+void List<T, Alloc>::swap(List<T, Alloc>& lst) noexcept {
+  if (this == &lst) {
+    return;
+  }
+  if constexpr (NodeAllocTraits::propagate_on_container_swap::value) {
+    std::swap(alloc_, lst.alloc_);
+  }
+  BaseNode* first = fakeNode_.next;
+  BaseNode* last = fakeNode_.prev;
+  size_t count = size_;
+  Slab* target = compactTarget_;
+  BaseNode* cursor = compactCursor_;
+  Slab** slabs = slabs_;
+  size_t slab_count = slabCount_;
+  size_t slab_space = slabSpace_;
+  StealRing(lst);
+  if (count != 0) {
+    lst.fakeNode_.next = first;
+    lst.fakeNode_.prev = last;
+    first->prev = &lst.fakeNode_;
+    last->next = &lst.fakeNode_;
+  }
+  lst.size_ = count;
+  lst.compactTarget_ = target;
+  lst.compactCursor_ = cursor;
+  lst.slabs_ = slabs;
+  lst.slabCount_ = slab_count;
+  lst.slabSpace_ = slab_space;
+}
 
-  before->next = tmp;
-  after->prev = tmp;
-  tmp->next = after;
-  tmp->prev = before;
+template<typename T, typename Alloc>
+void List<T, Alloc>::Relink(BaseNode* pos, BaseNode* first, BaseNode* last) noexcept {
+  if (first == last || pos == first || pos == last) {
+    return;
+  }
+  BaseNode* tail = last->prev;
+  first->prev->next = last;
+  last->prev = first->prev;
+
+  BaseNode* before = pos->prev;
+  before->next = first;
+  first->prev = before;
+  tail->next = pos;
+  pos->prev = tail;
 }
 
+// Equal allocators always relink; this list first records lst's slabs, so it can still tell slab
+// nodes apart when it erases them. lst stops compacting first: its target slab must not be freed by
+// this list while lst is still filling it.
 template<typename T, typename Alloc>
-void List<T, Alloc>::insert(const_iterator pos) {
-  Node* tmp = NodeAllocTraits::allocate(alloc_, 1);
+void List<T, Alloc>::TransferFrom(List& lst, BaseNode* pos, BaseNode* first, BaseNode* last, size_t count) {
+  if (this == &lst) {
+    Relink(pos, first, last);
+    return;
+  }
+  lst.StopCompaction();
+  if (alloc_ == lst.alloc_) {
+    AdoptSlabs(lst);
+    Relink(pos, first, last);
+    lst.size_ -= count;
+    size_ += count;
+    if (lst.size_ == 0) {
+      lst.DropSlabs();
+    }
+    return;
+  }
+  while (first != last) {
+    BaseNode* next = first->next;
+    emplace(const_iterator(pos), std::move(Value(first)));
+    lst.erase(const_iterator(first));
+    first = next;
+  }
+}
+
+// Takes both chains. If comp throws, left is left holding every node of both and right is null, so
+// the caller still owns all of them.
+template<typename T, typename Alloc>
+template<typename Compare>
+typename List<T, Alloc>::BaseNode* List<T, Alloc>::MergeChains(BaseNode*& left, BaseNode*& right, Compare& comp) {
+  BaseNode head;
+  BaseNode* tail = &head;
   try {
-    NodeAllocTraits::construct(alloc_, tmp);
+    while (left != nullptr && right != nullptr) {
+      if (comp(Value(right), Value(left))) {
+        tail->next = right;
+        right = right->next;
+      } else {
+        tail->next = left;
+        left = left->next;
+      }
+      tail = tail->next;
+    }
   } catch (...) {
-    NodeAllocTraits::deallocate(alloc_, tmp, 1);
+    tail->next = left;
+    while (tail->next != nullptr) {
+      tail = tail->next;
+    }
+    tail->next = right;
+    left = head.next;
+    right = nullptr;
     throw;
   }
-  ++size_;
+  tail->next = (left != nullptr ? left : right);
+  left = nullptr;
+  right = nullptr;
+  return head.next;
+}
+
+// Strings null-terminated chains back into the ring, one after another.
+template<typename T, typename Alloc>
+void List<T, Alloc>::Rethread(BaseNode* const* chains, size_t count) noexcept {
+  BaseNode* before = &fakeNode_;
+  for (size_t i = 0; i < count; ++i) {
+    for (BaseNode* node = chains[i]; node != nullptr; node = node->next) {
+      before->next = node;
+      node->prev = before;
+      before = node;
+    }
+  }
+  before->next = &fakeNode_;
+  fakeNode_.prev = before;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::splice(const_iterator pos, List<T, Alloc>& lst) {
+  TransferFrom(lst, pos.node, lst.fakeNode_.next, &lst.fakeNode_, lst.size_);
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::splice(const_iterator pos, List<T, Alloc>& lst, const_iterator it) {
+  TransferFrom(lst, pos.node, it.node, it.node->next, 1);
+}
 
-  BaseNode* after = pos.node;
-  --pos;
-  BaseNode* before = pos.node;
+template<typename T, typename Alloc>
+void List<T, Alloc>::splice(const_iterator pos, List<T, Alloc>& lst, const_iterator first, const_iterator last) {
+  size_t count = 0;
+  if (this != &lst) {
+    for (const_iterator it = first; it != last; ++it) {
+      ++count;
+    }
+  }
+  TransferFrom(lst, pos.node, first.node, last.node, count);
+}
 
-  before->next = tmp;
-  after->prev = tmp;
-  tmp->next = after;
-  tmp->prev = before;
+template<typename T, typename Alloc>
+template<typename Compare>
+void List<T, Alloc>::merge(List<T, Alloc>& lst, Compare comp) {
+  if (this == &lst) {
+    return;
+  }
+  BaseNode* cur = fakeNode_.next;
+  while (lst.fakeNode_.next != &lst.fakeNode_) {
+    BaseNode* first = lst.fakeNode_.next;
+    while (cur != &fakeNode_ && !comp(Value(first), Value(cur))) {
+      cur = cur->next;
+    }
+    BaseNode* last = first->next;
+    size_t count = 1;
+    if (cur == &fakeNode_) {
+      last = &lst.fakeNode_;
+      count = lst.size_;
+    } else {
+      while (last != &lst.fakeNode_ && comp(Value(last), Value(cur))) {
+        last = last->next;
+        ++count;
+      }
+    }
+    TransferFrom(lst, cur, first, last, count);
+  }
+}
+
+// Bottom-up merge sort on null-terminated chains. If comp throws, every chain still pending is put
+// back into the ring, so the list keeps all its elements in some order, as std::list::sort does.
+template<typename T, typename Alloc>
+template<typename Compare>
+void List<T, Alloc>::sort(Compare comp) {
+  if (size_ < 2) {
+    return;
+  }
+  // bins[64] holds the chain being merged, bins[65] the result, bins[66] the unsorted rest.
+  BaseNode* bins[67] = {};
+  BaseNode*& node = bins[64];
+  BaseNode*& result = bins[65];
+  BaseNode*& rest = bins[66];
+  size_t used = 0;
+
+  fakeNode_.prev->next = nullptr;
+  rest = fakeNode_.next;
+  try {
+    while (rest != nullptr) {
+      node = rest;
+      rest = rest->next;
+      node->next = nullptr;
+      size_t i = 0;
+      for (; i < used && bins[i] != nullptr; ++i) {
+        node = MergeChains(bins[i], node, comp);
+      }
+      if (i == used) {
+        ++used;
+      }
+      bins[i] = node;
+      node = nullptr;
+    }
+
+    for (size_t i = 0; i < used; ++i) {
+      if (bins[i] != nullptr) {
+        result = (result == nullptr ? std::exchange(bins[i], nullptr) : MergeChains(bins[i], result, comp));
+      }
+    }
+  } catch (...) {
+    Rethread(bins, 67);
+    throw;
+  }
+  Rethread(&result, 1);
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::reverse() noexcept {
+  BaseNode* node = &fakeNode_;
+  do {
+    std::swap(node->next, node->prev);
+    node = node->prev;
+  } while (node != &fakeNode_);
+}
+
+template<typename T, typename Alloc>
+template<typename BinaryPredicate>
+size_t List<T, Alloc>::unique(BinaryPredicate pred) {
+  size_t removed = 0;
+  if (size_ < 2) {
+    return removed;
+  }
+  BaseNode* kept = fakeNode_.next;
+  BaseNode* node = kept->next;
+  while (node != &fakeNode_) {
+    BaseNode* next = node->next;
+    if (pred(Value(kept), Value(node))) {
+      erase(const_iterator(node));
+      ++removed;
+    } else {
+      kept = node;
+    }
+    node = next;
+  }
+  return removed;
+}
+
+template<typename T, typename Alloc>
+template<typename Predicate>
+size_t List<T, Alloc>::remove_if(Predicate pred) {
+  size_t removed = 0;
+  BaseNode* node = fakeNode_.next;
+  while (node != &fakeNode_) {
+    BaseNode* next = node->next;
+    if (pred(Value(node))) {
+      erase(const_iterator(node));
+      ++removed;
+    }
+    node = next;
+  }
+  return removed;
+}
+
+// value may be an element of this list; that node is erased last, once nothing reads value any more.
+template<typename T, typename Alloc>
+size_t List<T, Alloc>::remove(const T& value) {
+  size_t removed = 0;
+  BaseNode* self = nullptr;
+  BaseNode* node = fakeNode_.next;
+  while (node != &fakeNode_) {
+    BaseNode* next = node->next;
+    if (Value(node) == value) {
+      if (std::addressof(Value(node)) == std::addressof(value)) {
+        self = node;
+      } else {
+        erase(const_iterator(node));
+      }
+      ++removed;
+    }
+    node = next;
+  }
+  if (self != nullptr) {
+    erase(const_iterator(self));
+  }
+  return removed;
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+typename List<T, Alloc>::iterator List<T, Alloc>::emplace(const_iterator pos, Args&&... args) {
+  Node* tmp = CreateNode(std::forward<Args>(args)...);
+  Link(pos.node, tmp);
+  return iterator(tmp);
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::insert(const_iterator pos, const T& value) {
+  emplace(pos, value);
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::insert(const_iterator pos, T&& value) {
+  emplace(pos, std::move(value));
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::insert(const_iterator pos) {
+  emplace(pos);
 }
 
 template<typename T, typename Alloc>
 void List<T, Alloc>::erase(const_iterator pos) {
-  --pos;
-  BaseNode* before = pos.node;
-  ++pos;
-  ++pos;
-  BaseNode* after = pos.node;
-  --pos;
-
-  Node* tmp = static_cast<Node*>(pos.node);
-  NodeAllocTraits::destroy(alloc_, tmp);
-  NodeAllocTraits::deallocate(alloc_, tmp, 1);
+  BaseNode* before = pos.node->prev;
+  BaseNode* after = pos.node->next;
+  if (pos.node == compactCursor_) {
+    compactCursor_ = after;
+  }
+  if (compactCursor_ == &fakeNode_) {
+    StopCompaction();
+  }
+
+  DestroyNode(static_cast<Node*>(pos.node));
   before->next = after;
   after->prev = before;
   --size_;
 }
 
+template<typename T, typename Alloc>
+template<typename InputIt, std::enable_if_t<!std::is_integral_v<InputIt>, int>>
+void List<T, Alloc>::assign(InputIt first, InputIt last) {
+  iterator it = begin();
+  for (; it != end() && first != last; ++it, ++first) {
+    *it = *first;
+  }
+  for (; first != last; ++first) {
+    emplace_back(*first);
+  }
+  while (it != end()) {
+    erase(it++);
+  }
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::assign(size_t n, const T& value) {
+  iterator it = begin();
+  for (; it != end() && n > 0; ++it, --n) {
+    *it = value;
+  }
+  for (; n > 0; --n) {
+    emplace_back(value);
+  }
+  while (it != end()) {
+    erase(it++);
+  }
+}
 
 template<typename T, typename Alloc>
 typename List<T, Alloc>::List<T, Alloc>& List<T, Alloc>::operator=(const List<T, Alloc>& lst) {
-  size_t last_size = size_;
-  size_t new_size = 0;
-  if (std::allocator_traits<Alloc>::propagate_on_container_copy_assignment::value) {
-    alloc_ = lst.alloc_;
+  if (this == &lst) {
+    return *this;
   }
-  try {
-    for (auto& it : lst) {
-      insert(end(), it);
-      ++new_size;
-    }
-  } catch (...) {
-    for (size_t i = 0; i < new_size; ++i) {
-      pop_back();
+  if constexpr (NodeAllocTraits::propagate_on_container_copy_assignment::value) {
+    if (alloc_ != lst.alloc_) {
+      clear();
     }
-    throw;
+    alloc_ = lst.alloc_;
   }
-  for (size_t i = 0; i < last_size; ++i) {
-    erase(begin());
+  assign(lst.begin(), lst.end());
+  return *this;
+}
+
+template<typename T, typename Alloc>
+typename List<T, Alloc>::List& List<T, Alloc>::operator=(List<T, Alloc>&& lst)
+    noexcept(NodeAllocTraits::propagate_on_container_move_assignment::value
+             || NodeAllocTraits::is_always_equal::value) {
+  if (this == &lst) {
+    return *this;
+  }
+  if constexpr (NodeAllocTraits::propagate_on_container_move_assignment::value) {
+    clear();
+    alloc_ = std::move(lst.alloc_);
+    StealRing(lst);
+  } else {
+    if (alloc_ == lst.alloc_) {
+      clear();
+      StealRing(lst);
+      return *this;
+    }
+    assign(std::make_move_iterator(lst.begin()), std::make_move_iterator(lst.end()));
+    lst.clear();
   }
   return *this;
 }
@@ -420,3 +1112,8 @@ List<T, Alloc>::List(const List<T, Alloc>& lst) : alloc_(std::allocator_traits<N
     throw;
   }
 }
+
+template<typename T, typename Alloc>
+List<T, Alloc>::List(List<T, Alloc>&& lst) noexcept : alloc_(std::move(lst.alloc_)), size_(0) {
+  StealRing(lst);
+}
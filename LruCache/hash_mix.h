@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+// std::hash of an integer is the integer itself. Multiplying by 2^64 / phi spreads consecutive keys
+// over the high bits, and folding the high half down spreads them over the low bits as well.
+inline size_t MixHash(size_t hash) {
+  hash *= static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+  return hash ^ (hash >> (4 * sizeof(size_t)));
+}
+
+// Tables index their slots with the low bits of a mixed hash; sharded ones pick the shard from the
+// high half, which the fold leaves untouched, so the two choices do not correlate.
+inline size_t ShardIndex(size_t mixed, size_t shards) {
+  return (mixed >> (4 * sizeof(size_t))) % shards;
+}
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
+#include "../List/list.h"
+#include "hash_mix.h"
+
+template<typename K, typename V, typename Alloc = std::allocator<std::pair<const K, V>>,
+         typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class LruCache {
+public:
+  using Entry = std::pair<const K, V>;
+  using Weigher = std::function<size_t(const K&, const V&)>;
+  using EvictionCallback = std::function<void(const K&, V&)>;
+
+private:
+  using EntryAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Entry>;
+  using Storage = List<Entry, EntryAlloc>;
+
+  struct Slot {
+    ListBaseNode* node;
+    size_t hash;
+  };
+
+  using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+  using SlotAllocTraits = std::allocator_traits<SlotAlloc>;
+
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  Storage entries_;
+  SlotAlloc slotAlloc_;
+  Slot* slots_;
+  size_t slotCount_;
+  size_t maxCount_;
+  size_t maxBytes_;
+  size_t bytes_;
+  Hash hash_;
+  KeyEqual equal_;
+  Weigher weigher_;
+  EvictionCallback onEvict_;
+
+  static Entry& EntryOf(ListBaseNode* node) {
+    return *typename Storage::iterator(node);
+  }
+
+  size_t Weight(const Entry& entry) const {
+    return maxBytes_ == 0 ? 0 : weigher_(entry.first, entry.second);
+  }
+
+  // Mixed, consecutive integer keys no longer form one long probe run that every backward shift has to walk.
+  size_t HashOf(const K& key) const {
+    return MixHash(hash_(key));
+  }
+
+  size_t Find(const K& key, size_t hash) const;
+  void Place(ListBaseNode* node, size_t hash);
+  void EraseSlot(size_t index);
+  void Rehash(size_t count);
+  void Touch(ListBaseNode* node);
+  void Evict();
+
+public:
+  explicit LruCache(size_t max_count, size_t max_bytes = 0, const Alloc& alloc = Alloc(),
+                    Weigher weigher = [](const K&, const V&) { return sizeof(Entry); });
+
+  LruCache(const LruCache& tmp) = delete;
+  LruCache& operator=(const LruCache& tmp) = delete;
+
+  void set_eviction_callback(EvictionCallback callback) {
+    onEvict_ = std::move(callback);
+  }
+
+  V* get(const K& key);
+  bool contains(const K& key) const;
+
+  template <typename... Args>
+  V& put(const K& key, Args&&... args);
+
+  bool erase(const K& key);
+  void clear();
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  size_t bytes() const {
+    return bytes_;
+  }
+
+  size_t max_count() const {
+    return maxCount_;
+  }
+
+  size_t max_bytes() const {
+    return maxBytes_;
+  }
+
+  typename Storage::const_iterator begin() const {
+    return entries_.begin();
+  }
+
+  typename Storage::const_iterator end() const {
+    return entries_.end();
+  }
+
+  ~LruCache();
+};
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+LruCache<K, V, Alloc, Hash, KeyEqual>::LruCache(size_t max_count, size_t max_bytes, const Alloc& alloc, Weigher weigher)
+    : entries_(EntryAlloc(alloc)), slotAlloc_(alloc), slots_(nullptr), slotCount_(0),
+      maxCount_(max_count), maxBytes_(max_bytes), bytes_(0), weigher_(std::move(weigher)) {
+  assert(max_count > 0);
+  size_t count = 8;
+  if (max_bytes == 0) {
+    while (count < 2 * max_count && count < (size_t(1) << 20)) {
+      count *= 2;
+    }
+  }
+  Rehash(count);
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+LruCache<K, V, Alloc, Hash, KeyEqual>::~LruCache() {
+  SlotAllocTraits::deallocate(slotAlloc_, slots_, slotCount_);
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+size_t LruCache<K, V, Alloc, Hash, KeyEqual>::Find(const K& key, size_t hash) const {
+  size_t mask = slotCount_ - 1;
+  for (size_t i = hash & mask; slots_[i].node != nullptr; i = (i + 1) & mask) {
+    if (slots_[i].hash == hash && equal_(EntryOf(slots_[i].node).first, key)) {
+      return i;
+    }
+  }
+  return kNotFound;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::Place(ListBaseNode* node, size_t hash) {
+  size_t mask = slotCount_ - 1;
+  size_t i = hash & mask;
+  while (slots_[i].node != nullptr) {
+    i = (i + 1) & mask;
+  }
+  slots_[i].node = node;
+  slots_[i].hash = hash;
+}
+
+// Linear probing with backward-shift deletion, so the table never collects tombstones.
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::EraseSlot(size_t index) {
+  size_t mask = slotCount_ - 1;
+  for (size_t j = (index + 1) & mask; slots_[j].node != nullptr; j = (j + 1) & mask) {
+    size_t home = slots_[j].hash & mask;
+    bool stays = (index <= j) ? (index < home && home <= j) : (index < home || home <= j);
+    if (!stays) {
+      slots_[index] = slots_[j];
+      index = j;
+    }
+  }
+  slots_[index].node = nullptr;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::Rehash(size_t count) {
+  Slot* old_slots = slots_;
+  size_t old_count = slotCount_;
+  slots_ = SlotAllocTraits::allocate(slotAlloc_, count);
+  slotCount_ = count;
+  for (size_t i = 0; i < count; ++i) {
+    slots_[i].node = nullptr;
+  }
+  for (size_t i = 0; i < old_count; ++i) {
+    if (old_slots[i].node != nullptr) {
+      Place(old_slots[i].node, old_slots[i].hash);
+    }
+  }
+  if (old_slots != nullptr) {
+    SlotAllocTraits::deallocate(slotAlloc_, old_slots, old_count);
+  }
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::Touch(ListBaseNode* node) {
+  entries_.splice(entries_.begin(), entries_, typename Storage::iterator(node));
+}
+
+// The most recently used entry is never evicted, even when it alone exceeds max_bytes.
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::Evict() {
+  while (entries_.size() > 1 && (entries_.size() > maxCount_ || (maxBytes_ != 0 && bytes_ > maxBytes_))) {
+    auto victim = --entries_.end();
+    if (onEvict_) {
+      onEvict_(victim->first, victim->second);
+    }
+    bytes_ -= Weight(*victim);
+    EraseSlot(Find(victim->first, HashOf(victim->first)));
+    entries_.erase(victim);
+  }
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+V* LruCache<K, V, Alloc, Hash, KeyEqual>::get(const K& key) {
+  size_t index = Find(key, HashOf(key));
+  if (index == kNotFound) {
+    return nullptr;
+  }
+  ListBaseNode* node = slots_[index].node;
+  Touch(node);
+  return &EntryOf(node).second;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+bool LruCache<K, V, Alloc, Hash, KeyEqual>::contains(const K& key) const {
+  return Find(key, HashOf(key)) != kNotFound;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+template<typename... Args>
+V& LruCache<K, V, Alloc, Hash, KeyEqual>::put(const K& key, Args&&... args) {
+  size_t hash = HashOf(key);
+  size_t index = Find(key, hash);
+  if (index != kNotFound) {
+    ListBaseNode* node = slots_[index].node;
+    Entry& entry = EntryOf(node);
+    V value(std::forward<Args>(args)...);
+    size_t old_weight = Weight(entry);
+    entry.second = std::move(value);
+    bytes_ = bytes_ - old_weight + Weight(entry);
+    Touch(node);
+    Evict();
+    return entry.second;
+  }
+
+  if (2 * (entries_.size() + 1) > slotCount_) {
+    Rehash(2 * slotCount_);
+  }
+  Entry& entry = entries_.emplace_front(std::piecewise_construct, std::forward_as_tuple(key),
+                                        std::forward_as_tuple(std::forward<Args>(args)...));
+  Place(entries_.begin().node, hash);
+  bytes_ += Weight(entry);
+  Evict();
+  return entry.second;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+bool LruCache<K, V, Alloc, Hash, KeyEqual>::erase(const K& key) {
+  size_t index = Find(key, HashOf(key));
+  if (index == kNotFound) {
+    return false;
+  }
+  typename Storage::iterator it(slots_[index].node);
+  bytes_ -= Weight(*it);
+  EraseSlot(index);
+  entries_.erase(it);
+  return true;
+}
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+void LruCache<K, V, Alloc, Hash, KeyEqual>::clear() {
+  for (size_t i = 0; i < slotCount_; ++i) {
+    slots_[i].node = nullptr;
+  }
+  entries_.clear();
+  bytes_ = 0;
+}
+
+template<typename K, typename V, typename Alloc = std::allocator<std::pair<const K, V>>,
+         typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class ShardedLruCache {
+private:
+  using Cache = LruCache<K, V, Alloc, Hash, KeyEqual>;
+
+  struct Shard {
+    std::mutex mutex;
+    Cache cache;
+
+    Shard(size_t max_count, size_t max_bytes, const Alloc& alloc, typename Cache::Weigher weigher)
+        : cache(max_count, max_bytes, alloc, std::move(weigher)) {}
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  Hash hash_;
+
+  Shard& ShardOf(const K& key) {
+    return *shards_[ShardIndex(MixHash(hash_(key)), shards_.size())];
+  }
+
+public:
+  ShardedLruCache(size_t shards, size_t max_count, size_t max_bytes = 0, const Alloc& alloc = Alloc(),
+                  typename Cache::Weigher weigher = [](const K&, const V&) { return sizeof(typename Cache::Entry); });
+
+  void set_eviction_callback(typename Cache::EvictionCallback callback) {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->cache.set_eviction_callback(callback);
+    }
+  }
+
+  std::optional<V> get(const K& key) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    V* value = shard.cache.get(key);
+    return value == nullptr ? std::nullopt : std::optional<V>(*value);
+  }
+
+  template <typename... Args>
+  void put(const K& key, Args&&... args) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.put(key, std::forward<Args>(args)...);
+  }
+
+  bool erase(const K& key) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.erase(key);
+  }
+
+  size_t size() {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      total += shard->cache.size();
+    }
+    return total;
+  }
+};
+
+template<typename K, typename V, typename Alloc, typename Hash, typename KeyEqual>
+ShardedLruCache<K, V, Alloc, Hash, KeyEqual>::ShardedLruCache(size_t shards, size_t max_count, size_t max_bytes,
+                                                               const Alloc& alloc, typename Cache::Weigher weigher) {
+  assert(shards > 0);
+  size_t shard_count = std::max<size_t>(1, (max_count + shards - 1) / shards);
+  size_t shard_bytes = (max_bytes + shards - 1) / shards;
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>(shard_count, shard_bytes, alloc, weigher));
+  }
+}
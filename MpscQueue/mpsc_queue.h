@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include "../List/list.h"
+
+// Vyukov's intrusive multi-producer/single-consumer queue. Nodes are List<T, Alloc> nodes, so a drained
+// batch can be linked into a List without copying. push/emplace may be called from any thread;
+// try_pop/drain only from the single consumer.
+template<typename T, typename Alloc = std::allocator<T>>
+class MpscQueue {
+private:
+  using BaseNode = ListBaseNode;
+  using Storage = List<T, Alloc>;
+  using Node = typename Storage::Node;
+  using NodeAlloc = typename Storage::NodeAlloc;
+  using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+
+  NodeAlloc alloc_;
+  alignas(64) std::atomic<BaseNode*> head_;
+  alignas(64) BaseNode* tail_;
+  BaseNode stub_;
+
+  static std::atomic_ref<BaseNode*> NextOf(BaseNode* node) {
+    return std::atomic_ref<BaseNode*>(node->next);
+  }
+
+  void PushNode(BaseNode* node);
+  Node* PopNode();
+  void DestroyNode(Node* node);
+
+public:
+  explicit MpscQueue(const Alloc& alloc = Alloc());
+
+  MpscQueue(const MpscQueue& tmp) = delete;
+  MpscQueue& operator=(const MpscQueue& tmp) = delete;
+
+  template <typename... Args>
+  void emplace(Args&&... args);
+
+  void push(const T& value) {
+    emplace(value);
+  }
+
+  void push(T&& value) {
+    emplace(std::move(value));
+  }
+
+  std::optional<T> try_pop();
+  size_t drain(Storage& lst, size_t max_count = static_cast<size_t>(-1));
+
+  bool empty() const {
+    return tail_ == &stub_ && NextOf(const_cast<BaseNode*>(&stub_)).load(std::memory_order_acquire) == nullptr;
+  }
+
+  ~MpscQueue();
+};
+
+template<typename T, typename Alloc>
+MpscQueue<T, Alloc>::MpscQueue(const Alloc& alloc) : alloc_(alloc), head_(&stub_), tail_(&stub_) {
+  stub_.next = nullptr;
+  stub_.prev = nullptr;
+}
+
+template<typename T, typename Alloc>
+MpscQueue<T, Alloc>::~MpscQueue() {
+  while (Node* node = PopNode()) {
+    DestroyNode(node);
+  }
+}
+
+template<typename T, typename Alloc>
+void MpscQueue<T, Alloc>::PushNode(BaseNode* node) {
+  NextOf(node).store(nullptr, std::memory_order_relaxed);
+  BaseNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+  NextOf(prev).store(node, std::memory_order_release);
+}
+
+// Returns nullptr when the queue is empty or a producer is between its exchange and its link.
+template<typename T, typename Alloc>
+typename MpscQueue<T, Alloc>::Node* MpscQueue<T, Alloc>::PopNode() {
+  BaseNode* tail = tail_;
+  BaseNode* next = NextOf(tail).load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (next == nullptr) {
+      return nullptr;
+    }
+    tail_ = next;
+    tail = next;
+    next = NextOf(next).load(std::memory_order_acquire);
+  }
+  if (next != nullptr) {
+    tail_ = next;
+    return static_cast<Node*>(tail);
+  }
+  if (tail != head_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  PushNode(&stub_);
+  next = NextOf(tail).load(std::memory_order_acquire);
+  if (next != nullptr) {
+    tail_ = next;
+    return static_cast<Node*>(tail);
+  }
+  return nullptr;
+}
+
+template<typename T, typename Alloc>
+void MpscQueue<T, Alloc>::DestroyNode(Node* node) {
+  NodeAllocTraits::destroy(alloc_, node);
+  NodeAllocTraits::deallocate(alloc_, node, 1);
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+void MpscQueue<T, Alloc>::emplace(Args&&... args) {
+  Node* node = NodeAllocTraits::allocate(alloc_, 1);
+  try {
+    NodeAllocTraits::construct(alloc_, node, std::forward<Args>(args)...);
+  } catch (...) {
+    NodeAllocTraits::deallocate(alloc_, node, 1);
+    throw;
+  }
+  PushNode(node);
+}
+
+template<typename T, typename Alloc>
+std::optional<T> MpscQueue<T, Alloc>::try_pop() {
+  Node* node = PopNode();
+  if (node == nullptr) {
+    return std::nullopt;
+  }
+  std::optional<T> result(std::move(node->value));
+  DestroyNode(node);
+  return result;
+}
+
+// Pops up to max_count elements and appends them to lst. With equal allocators the popped nodes
+// themselves are linked in, so the hand-over to lst is a single O(1) splice.
+template<typename T, typename Alloc>
+size_t MpscQueue<T, Alloc>::drain(Storage& lst, size_t max_count) {
+  if (!(alloc_ == lst.alloc_)) {
+    size_t count = 0;
+    for (; count < max_count; ++count) {
+      Node* node = PopNode();
+      if (node == nullptr) {
+        break;
+      }
+      lst.emplace_back(std::move(node->value));
+      DestroyNode(node);
+    }
+    return count;
+  }
+
+  BaseNode* first = nullptr;
+  BaseNode* last = nullptr;
+  size_t count = 0;
+  for (; count < max_count; ++count) {
+    Node* node = PopNode();
+    if (node == nullptr) {
+      break;
+    }
+    node->prev = last;
+    if (last == nullptr) {
+      first = node;
+    } else {
+      last->next = node;
+    }
+    last = node;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  BaseNode* before = lst.fakeNode_.prev;
+  before->next = first;
+  first->prev = before;
+  last->next = &lst.fakeNode_;
+  lst.fakeNode_.prev = last;
+  lst.size_ += count;
+  return count;
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum class PerfEvent { Cycles, Instructions, L1dMisses, LlcMisses, BranchMisses, DtlbMisses };
+
+// Hardware counters of the calling thread, and of threads it starts while counting, through
+// perf_event_open. Every event is opened on its own, so a kernel, VM or perf_event_paranoid setting
+// that refuses some of them still yields the rest; where none can be opened (or off Linux) every
+// value is reported unavailable and start/stop do nothing. Counts are scaled up when the kernel had
+// to multiplex a counter.
+class PerfCounters {
+public:
+  static constexpr size_t kEvents = 6;
+
+  struct Sample {
+    std::array<double, kEvents> values{};
+    std::array<bool, kEvents> valid{};
+
+    double operator[](PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+    bool has(PerfEvent event) const { return valid[static_cast<size_t>(event)]; }
+
+    Sample& operator+=(const Sample& tmp);
+    Sample operator-(const Sample& tmp) const;
+  };
+
+  PerfCounters();
+
+  PerfCounters(const PerfCounters& tmp) = delete;
+  PerfCounters& operator=(const PerfCounters& tmp) = delete;
+
+  bool available() const;
+  bool available(PerfEvent event) const { return fds_[static_cast<size_t>(event)] >= 0; }
+
+  // Zeroes and enables the counters; stop() disables them and returns the counts since start().
+  void start();
+  Sample stop();
+
+  // Running totals, for callers that keep the counters enabled and subtract.
+  Sample read() const;
+
+  static const char* name(PerfEvent event);
+
+  ~PerfCounters();
+
+private:
+  std::array<int, kEvents> fds_;
+
+  void Control(unsigned long request);
+};
+
+inline PerfCounters::Sample& PerfCounters::Sample::operator+=(const Sample& tmp) {
+  for (size_t i = 0; i < kEvents; ++i) {
+    values[i] += tmp.values[i];
+    valid[i] = valid[i] || tmp.valid[i];
+  }
+  return *this;
+}
+
+inline PerfCounters::Sample PerfCounters::Sample::operator-(const Sample& tmp) const {
+  Sample result;
+  for (size_t i = 0; i < kEvents; ++i) {
+    result.values[i] = values[i] - tmp.values[i];
+    result.valid[i] = valid[i] && tmp.valid[i];
+  }
+  return result;
+}
+
+inline const char* PerfCounters::name(PerfEvent event) {
+  static const char* const names[kEvents] = {"cycles",         "instructions",  "l1d_misses",
+                                             "llc_misses",     "branch_misses", "dtlb_misses"};
+  return names[static_cast<size_t>(event)];
+}
+
+inline bool PerfCounters::available() const {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef __linux__
+
+inline PerfCounters::PerfCounters() {
+  auto cache = [](uint64_t level, uint64_t op, uint64_t result) { return level | (op << 8) | (result << 16); };
+  const std::array<std::pair<uint32_t, uint64_t>, kEvents> events = {{
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  }};
+  for (size_t i = 0; i < kEvents; ++i) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = events[i].first;
+    attr.config = events[i].second;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+}
+
+inline PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+inline void PerfCounters::Control(unsigned long request) {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, request, 0);
+    }
+  }
+}
+
+inline void PerfCounters::start() {
+  Control(PERF_EVENT_IOC_RESET);
+  Control(PERF_EVENT_IOC_ENABLE);
+}
+
+inline PerfCounters::Sample PerfCounters::stop() {
+  Control(PERF_EVENT_IOC_DISABLE);
+  return read();
+}
+
+// A counter that never got scheduled on the PMU has nothing to scale and stays invalid.
+inline PerfCounters::Sample PerfCounters::read() const {
+  Sample sample;
+  for (size_t i = 0; i < kEvents; ++i) {
+    uint64_t data[3] = {0, 0, 0};
+    if (fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+      continue;
+    }
+    if (data[2] == 0) {
+      sample.valid[i] = data[1] == 0;
+      continue;
+    }
+    sample.values[i] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    sample.valid[i] = true;
+  }
+  return sample;
+}
+
+#else
+
+inline PerfCounters::PerfCounters() {
+  fds_.fill(-1);
+}
+
+inline PerfCounters::~PerfCounters() = default;
+
+inline void PerfCounters::Control(unsigned long) {}
+
+inline void PerfCounters::start() {}
+
+inline PerfCounters::Sample PerfCounters::stop() {
+  return Sample();
+}
+
+inline PerfCounters::Sample PerfCounters::read() const {
+  return Sample();
+}
+
+#endif
+
+// Scoped probes for production code. With PERF_PROBES defined, PERF_PROBE("name") counts the rest
+// of the enclosing scope on a per-thread PerfCounters and adds the difference to a process-wide table
+// that PerfProbes::report prints; nested probes each see their full scope. Without it the macro
+// expands to nothing, so probes can stay in hot paths.
+class PerfProbes {
+public:
+  struct Totals {
+    uint64_t calls = 0;
+    PerfCounters::Sample counts;
+  };
+
+  class Scope {
+  public:
+    explicit Scope(const char* name) : name_(name), begin_(Counters().read()) {}
+
+    Scope(const Scope& tmp) = delete;
+    Scope& operator=(const Scope& tmp) = delete;
+
+    ~Scope() { Add(name_, Counters().read() - begin_); }
+
+  private:
+    const char* name_;
+    PerfCounters::Sample begin_;
+  };
+
+  static std::map<std::string, Totals> snapshot() {
+    std::lock_guard<std::mutex> lock(GetTable().mutex);
+    return GetTable().totals;
+  }
+
+  // One line per probe: calls, then every available event per call.
+  static void report(std::ostream& out);
+
+private:
+  struct Table {
+    std::mutex mutex;
+    std::map<std::string, Totals> totals;
+  };
+
+  // Left alive at exit: probes may still run in static destructors.
+  static Table& GetTable() {
+    static Table* table = new Table();
+    return *table;
+  }
+
+  static PerfCounters& Counters() {
+    thread_local PerfCounters counters;
+    thread_local bool started = (counters.start(), true);
+    static_cast<void>(started);
+    return counters;
+  }
+
+  static void Add(const char* name, const PerfCounters::Sample& counts) {
+    std::lock_guard<std::mutex> lock(GetTable().mutex);
+    Totals& totals = GetTable().totals[name];
+    ++totals.calls;
+    totals.counts += counts;
+  }
+};
+
+inline void PerfProbes::report(std::ostream& out) {
+  for (const auto& [name, totals] : snapshot()) {
+    out << name << ": calls=" << totals.calls;
+    for (size_t i = 0; i < PerfCounters::kEvents; ++i) {
+      if (totals.counts.valid[i]) {
+        out << ' ' << PerfCounters::name(static_cast<PerfEvent>(i)) << '='
+            << totals.counts.values[i] / static_cast<double>(totals.calls);
+      }
+    }
+    out << '\n';
+  }
+}
+
+#define PERF_PROBE_CONCAT_INNER(a, b) a##b
+#define PERF_PROBE_CONCAT(a, b) PERF_PROBE_CONCAT_INNER(a, b)
+
+#ifdef PERF_PROBES
+#define PERF_PROBE(name) PerfProbes::Scope PERF_PROBE_CONCAT(perf_probe_, __LINE__)(name)
+#else
+#define PERF_PROBE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <iterator>
+#include "../SharedPtr/shared_ptr.h"
+
+// Immutable singly-linked list. Every version shares its tail with the version it was built from,
+// so cons and pop are O(1) and never copy elements.
+template<typename T, typename Alloc = std::allocator<T>>
+class PersistentList {
+private:
+  struct Node {
+    T value;
+    SharedPtr<Node> next;
+
+    template <typename... Args>
+    Node(const SharedPtr<Node>& tail, Args&&... args) : value(std::forward<Args>(args)...), next(tail) {}
+
+    // Unique successors are unlinked one at a time, so a long chain never recurses through ~SharedPtr.
+    ~Node() {
+      while (next.get() != nullptr && next.use_count() == 1) {
+        SharedPtr<Node> tmp = std::move(next->next);
+        next = std::move(tmp);
+      }
+    }
+  };
+
+  using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+
+  SharedPtr<Node> head_;
+  size_t size_;
+  NodeAlloc alloc_;
+
+  PersistentList(SharedPtr<Node> head, size_t size, const NodeAlloc& alloc)
+      : head_(std::move(head)), size_(size), alloc_(alloc) {}
+
+public:
+  struct const_iterator {
+    using value_type = const T;
+    using pointer = const T*;
+    using difference_type = int;
+    using reference = const T&;
+    using iterator_category = std::forward_iterator_tag;
+
+    const Node* node;
+
+    const_iterator() = default;
+    const_iterator(const Node* tmp) : node(tmp) {}
+
+    const_iterator& operator++() {
+      node = node->next.get();
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      node = node->next.get();
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& tmp) const {
+      return node == tmp.node;
+    }
+
+    bool operator!=(const const_iterator& tmp) const {
+      return node != tmp.node;
+    }
+
+    reference operator*() const {
+      return node->value;
+    }
+
+    pointer operator->() const {
+      return &node->value;
+    }
+  };
+
+  using iterator = const_iterator;
+
+  explicit PersistentList(const Alloc& alloc = Alloc()) : size_(0), alloc_(alloc) {}
+
+  template <typename... Args>
+  PersistentList emplace_front(Args&&... args) const {
+    SharedPtr<Node> node = allocateShared<Node>(alloc_, head_, std::forward<Args>(args)...);
+    return PersistentList(std::move(node), size_ + 1, alloc_);
+  }
+
+  PersistentList push_front(const T& value) const {
+    return emplace_front(value);
+  }
+
+  PersistentList push_front(T&& value) const {
+    return emplace_front(std::move(value));
+  }
+
+  PersistentList pop_front() const {
+    return PersistentList(head_->next, size_ - 1, alloc_);
+  }
+
+  const T& front() const {
+    return head_->value;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const_iterator begin() const {
+    return const_iterator(head_.get());
+  }
+
+  const_iterator end() const {
+    return const_iterator(nullptr);
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "shared_ptr.h"
+
+// Lock-free atomic SharedPtr using split reference counts. The published value lives in a Holder;
+// the atomic word packs the Holder pointer (low 48 bits) with a count of readers currently copying
+// out of it (high 16 bits). A reader bumps that local count, copies the SharedPtr and gives the
+// count back; if a writer swapped the Holder out meanwhile, the writer has moved the outstanding
+// local count into Holder::refs and the reader drops its share there instead. Writers never wait
+// for readers, and readers only ever retry a CAS.
+template<typename T>
+class AtomicSharedPtr {
+private:
+  static_assert(sizeof(void*) == 8, "AtomicSharedPtr packs a 48-bit pointer and a 16-bit count");
+
+  static constexpr int kCountShift = 48;
+  static constexpr uint64_t kOne = uint64_t(1) << kCountShift;
+  static constexpr uint64_t kPointerMask = kOne - 1;
+  static constexpr int64_t kBias = int64_t(1) << 40;
+
+  struct Holder {
+    SharedPtr<T> value;
+    // kBias while published; on retire the outstanding local count is added and the bias removed,
+    // so whichever of the writer or the last straggling reader brings it to zero frees the Holder.
+    std::atomic<int64_t> refs;
+
+    Holder(SharedPtr<T> value) : value(std::move(value)), refs(kBias) {}
+  };
+
+  std::atomic<uint64_t> word_;
+
+  static Holder* HolderOf(uint64_t word) {
+    return reinterpret_cast<Holder*>(static_cast<uintptr_t>(word & kPointerMask));
+  }
+
+  static int64_t CountOf(uint64_t word) {
+    return static_cast<int64_t>(word >> kCountShift);
+  }
+
+  static uint64_t Publish(SharedPtr<T> value) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(new Holder(std::move(value))));
+  }
+
+  static bool SameOwner(const SharedPtr<T>& left, const SharedPtr<T>& right) {
+    return left.cb == right.cb && left.ptr == right.ptr;
+  }
+
+  static void DropRefs(Holder* holder, int64_t count) {
+    if (holder->refs.fetch_sub(count, std::memory_order_acq_rel) == count) {
+      delete holder;
+    }
+  }
+
+  uint64_t Acquire() const;
+  void Release(Holder* holder) const;
+  static void Retire(uint64_t word, int64_t own);
+
+public:
+  AtomicSharedPtr() : word_(Publish(SharedPtr<T>())) {}
+  AtomicSharedPtr(SharedPtr<T> value) : word_(Publish(std::move(value))) {}
+
+  AtomicSharedPtr(const AtomicSharedPtr& tmp) = delete;
+  AtomicSharedPtr& operator=(const AtomicSharedPtr& tmp) = delete;
+
+  AtomicSharedPtr& operator=(SharedPtr<T> value) {
+    store(std::move(value));
+    return *this;
+  }
+
+  SharedPtr<T> load() const;
+  void store(SharedPtr<T> value);
+  SharedPtr<T> exchange(SharedPtr<T> value);
+  bool compare_exchange_strong(SharedPtr<T>& expected, SharedPtr<T> desired);
+
+  bool compare_exchange_weak(SharedPtr<T>& expected, SharedPtr<T> desired) {
+    return compare_exchange_strong(expected, std::move(desired));
+  }
+
+  operator SharedPtr<T>() const {
+    return load();
+  }
+
+  bool is_lock_free() const {
+    return word_.is_lock_free();
+  }
+
+  ~AtomicSharedPtr() {
+    Retire(word_.load(std::memory_order_acquire), 0);
+  }
+};
+
+// Takes one local reference on the current Holder and returns the word it was taken against.
+template<typename T>
+uint64_t AtomicSharedPtr<T>::Acquire() const {
+  return const_cast<std::atomic<uint64_t>&>(word_).fetch_add(kOne, std::memory_order_acquire) + kOne;
+}
+
+template<typename T>
+void AtomicSharedPtr<T>::Release(Holder* holder) const {
+  auto& word = const_cast<std::atomic<uint64_t>&>(word_);
+  uint64_t current = word.load(std::memory_order_relaxed);
+  while (HolderOf(current) == holder) {
+    if (word.compare_exchange_weak(current, current - kOne, std::memory_order_release, std::memory_order_relaxed)) {
+      return;
+    }
+  }
+  DropRefs(holder, 1);
+}
+
+// Called once per Holder by whoever unpublished it; own is the number of the caller's local
+// references included in word, which are released here as well.
+template<typename T>
+void AtomicSharedPtr<T>::Retire(uint64_t word, int64_t own) {
+  DropRefs(HolderOf(word), kBias - CountOf(word) + own);
+}
+
+template<typename T>
+SharedPtr<T> AtomicSharedPtr<T>::load() const {
+  Holder* holder = HolderOf(Acquire());
+  SharedPtr<T> result = holder->value;
+  Release(holder);
+  return result;
+}
+
+template<typename T>
+void AtomicSharedPtr<T>::store(SharedPtr<T> value) {
+  exchange(std::move(value));
+}
+
+template<typename T>
+SharedPtr<T> AtomicSharedPtr<T>::exchange(SharedPtr<T> value) {
+  uint64_t old = word_.exchange(Publish(std::move(value)), std::memory_order_acq_rel);
+  SharedPtr<T> result = HolderOf(old)->value;
+  Retire(old, 0);
+  return result;
+}
+
+template<typename T>
+bool AtomicSharedPtr<T>::compare_exchange_strong(SharedPtr<T>& expected, SharedPtr<T> desired) {
+  uint64_t fresh = 0;
+  while (true) {
+    uint64_t current = Acquire();
+    Holder* holder = HolderOf(current);
+    if (!SameOwner(holder->value, expected)) {
+      expected = holder->value;
+      Release(holder);
+      if (fresh != 0) {
+        delete HolderOf(fresh);
+      }
+      return false;
+    }
+    if (fresh == 0) {
+      fresh = Publish(std::move(desired));
+    }
+    while (HolderOf(current) == holder) {
+      if (word_.compare_exchange_weak(current, fresh, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        Retire(current, 1);
+        return true;
+      }
+    }
+    // Another writer got in first; the Holder we compared against is gone, so compare again.
+    Release(holder);
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <utility>
+#include "shared_ptr.h"
+
+template <typename T>
+class CompactSharedPtr;
+
+template <typename T, typename... Args>
+CompactSharedPtr<T> makeCompact(Args&&... args);
+
+// One-pointer owning handle to an object built by makeShared. The object sits at a fixed offset in
+// its ControlBlockMakeShared, so only the block is stored and get() is an add. Shares counts with
+// SharedPtr and WeakPtr: to_shared() and from_shared() convert without touching the object. Pair it
+// with SHARED_PTR_32BIT_COUNTS to shrink the block as well.
+template <typename T>
+class CompactSharedPtr {
+private:
+  static_assert(!std::is_array_v<T> && !std::is_const_v<T>, "CompactSharedPtr holds makeShared<T> objects");
+
+  using Block = typename SharedPtr<T>::template ControlBlockMakeShared<T, std::allocator<T>>;
+
+  template <typename U, typename... Args>
+  friend CompactSharedPtr<U> makeCompact(Args&&... args);
+
+  Block* block_;
+
+  explicit CompactSharedPtr(Block* block) noexcept: block_(block) {}
+
+  static T* ObjectOf(Block* block) noexcept {
+    return reinterpret_cast<T*>(block->object);
+  }
+
+  // Takes over the reference of a SharedPtr fresh from makeShared<T>.
+  static CompactSharedPtr Adopt(SharedPtr<T>&& tmp) noexcept {
+    Block* block = static_cast<Block*>(tmp.cb);
+    tmp.cb = nullptr;
+    tmp.ptr = nullptr;
+    return CompactSharedPtr(block);
+  }
+
+public:
+  CompactSharedPtr() noexcept: block_(nullptr) {}
+
+  CompactSharedPtr(const CompactSharedPtr& tmp) noexcept: block_(tmp.block_) {
+    if (block_ != nullptr) {
+      block_->IncreaseShared();
+    }
+  }
+
+  CompactSharedPtr(CompactSharedPtr&& tmp) noexcept: block_(tmp.block_) {
+    tmp.block_ = nullptr;
+  }
+
+  CompactSharedPtr& operator=(const CompactSharedPtr& tmp) noexcept {
+    CompactSharedPtr(tmp).swap(*this);
+    return *this;
+  }
+
+  CompactSharedPtr& operator=(CompactSharedPtr&& tmp) noexcept {
+    CompactSharedPtr(std::move(tmp)).swap(*this);
+    return *this;
+  }
+
+  // Empty unless tmp owns and points at an object made by makeShared<T>.
+  static CompactSharedPtr from_shared(const SharedPtr<T>& tmp) noexcept {
+    BaseControlBlock* cb = tmp.cb;
+    if (cb == nullptr || cb->hook(cb, BaseControlBlock::Operation::Kind) != BaseControlBlock::KindOf<Block>()) {
+      return CompactSharedPtr();
+    }
+    Block* block = static_cast<Block*>(cb);
+    if (ObjectOf(block) != tmp.ptr) {
+      return CompactSharedPtr();
+    }
+    block->IncreaseShared();
+    return CompactSharedPtr(block);
+  }
+
+  SharedPtr<T> to_shared() const {
+    if (block_ == nullptr) {
+      return SharedPtr<T>();
+    }
+    return SharedPtr<T>(block_, ObjectOf(block_));
+  }
+
+  void reset() noexcept {
+    CompactSharedPtr().swap(*this);
+  }
+
+  void swap(CompactSharedPtr& tmp) noexcept {
+    std::swap(block_, tmp.block_);
+  }
+
+  T* get() const noexcept { return block_ == nullptr ? nullptr : ObjectOf(block_); }
+  T& operator*() const noexcept { return *ObjectOf(block_); }
+  T* operator->() const noexcept { return ObjectOf(block_); }
+
+  explicit operator bool() const noexcept { return block_ != nullptr; }
+
+  size_t use_count() const noexcept { return block_ == nullptr ? 0 : block_->GiveShared(); }
+
+  ~CompactSharedPtr() {
+    if (block_ != nullptr) {
+      block_->Shared_TryToDeleteThisOne();
+    }
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const CompactSharedPtr<T>& left, const CompactSharedPtr<U>& right) {
+  return left.get() == right.get();
+}
+
+template <typename T, typename U>
+bool operator!=(const CompactSharedPtr<T>& left, const CompactSharedPtr<U>& right) {
+  return left.get() != right.get();
+}
+
+template <typename T, typename... Args>
+CompactSharedPtr<T> makeCompact(Args&&... args) {
+  return CompactSharedPtr<T>::Adopt(makeShared<T>(std::forward<Args>(args)...));
+}
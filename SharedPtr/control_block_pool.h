@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <vector>
+
+// Free-list pool for one size class. Freed blocks go to the releasing thread's cache, whichever
+// thread allocated them; caches spill into and refill from a mutex-guarded global list, and hand
+// everything back to it when their thread exits. Chunks are kept for the life of the process.
+template<size_t Size>
+class ControlBlockPool {
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static_assert(Size >= sizeof(FreeBlock) && Size % alignof(std::max_align_t) == 0);
+
+  static constexpr size_t kChunkBlocks = 256;
+  static constexpr size_t kCacheLimit = 128;
+  static constexpr size_t kBatch = kCacheLimit / 2;
+
+  struct Global {
+    std::mutex mutex;
+    FreeBlock* head = nullptr;
+    std::vector<void*> chunks;
+  };
+
+  struct Cache {
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+
+    ~Cache() {
+      Flush(*this, count);
+      CacheGone() = true;
+    }
+  };
+
+  // Never destroyed, so blocks released during static destruction still have somewhere to go.
+  static Global& GetGlobal() {
+    static Global* global = new Global;
+    return *global;
+  }
+
+  static Cache& GetCache() {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  // Set once the thread's cache is destroyed; later releases on that thread go straight to the global list.
+  static bool& CacheGone() {
+    thread_local bool gone = false;
+    return gone;
+  }
+
+  static FreeBlock* CarveChunk(Global& global);
+  static void Refill(Cache& cache);
+  static void Flush(Cache& cache, size_t count);
+
+public:
+  static void* allocate();
+  static void deallocate(void* ptr) noexcept;
+};
+
+// Called with global.mutex held. Returns a singly-linked run of kChunkBlocks fresh blocks.
+template<size_t Size>
+typename ControlBlockPool<Size>::FreeBlock* ControlBlockPool<Size>::CarveChunk(Global& global) {
+  char* chunk = static_cast<char*>(::operator new(Size * kChunkBlocks));
+  global.chunks.push_back(chunk);
+  for (size_t i = 0; i + 1 < kChunkBlocks; ++i) {
+    reinterpret_cast<FreeBlock*>(chunk + i * Size)->next = reinterpret_cast<FreeBlock*>(chunk + (i + 1) * Size);
+  }
+  reinterpret_cast<FreeBlock*>(chunk + (kChunkBlocks - 1) * Size)->next = nullptr;
+  return reinterpret_cast<FreeBlock*>(chunk);
+}
+
+template<size_t Size>
+void ControlBlockPool<Size>::Refill(Cache& cache) {
+  Global& global = GetGlobal();
+  std::lock_guard<std::mutex> lock(global.mutex);
+  if (global.head == nullptr) {
+    cache.head = CarveChunk(global);
+    cache.count = kChunkBlocks;
+    return;
+  }
+  FreeBlock* first = global.head;
+  FreeBlock* last = first;
+  size_t count = 1;
+  while (count < kBatch && last->next != nullptr) {
+    last = last->next;
+    ++count;
+  }
+  global.head = last->next;
+  last->next = nullptr;
+  cache.head = first;
+  cache.count = count;
+}
+
+template<size_t Size>
+void ControlBlockPool<Size>::Flush(Cache& cache, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  FreeBlock* first = cache.head;
+  FreeBlock* last = first;
+  for (size_t i = 1; i < count; ++i) {
+    last = last->next;
+  }
+  cache.head = last->next;
+  cache.count -= count;
+
+  Global& global = GetGlobal();
+  std::lock_guard<std::mutex> lock(global.mutex);
+  last->next = global.head;
+  global.head = first;
+}
+
+template<size_t Size>
+void* ControlBlockPool<Size>::allocate() {
+  if (CacheGone()) {
+    Global& global = GetGlobal();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    if (global.head == nullptr) {
+      global.head = CarveChunk(global);
+    }
+    FreeBlock* block = global.head;
+    global.head = block->next;
+    return block;
+  }
+  Cache& cache = GetCache();
+  if (cache.head == nullptr) {
+    Refill(cache);
+  }
+  FreeBlock* block = cache.head;
+  cache.head = block->next;
+  --cache.count;
+  return block;
+}
+
+template<size_t Size>
+void ControlBlockPool<Size>::deallocate(void* ptr) noexcept {
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  if (CacheGone()) {
+    Global& global = GetGlobal();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    block->next = global.head;
+    global.head = block;
+    return;
+  }
+  Cache& cache = GetCache();
+  block->next = cache.head;
+  cache.head = block;
+  if (++cache.count > kCacheLimit) {
+    Flush(cache, kBatch);
+  }
+}
+
+// Single-object requests up to kMaxPooledSize bytes come from the matching ControlBlockPool;
+// anything else falls through to std::allocator.
+template<typename T>
+class PoolAllocator {
+private:
+  static constexpr size_t kAlign = alignof(std::max_align_t);
+  static constexpr size_t kMaxPooledSize = 256;
+  static constexpr size_t kSizeClass = (sizeof(T) + kAlign - 1) / kAlign * kAlign;
+  static constexpr bool kPooled = kSizeClass <= kMaxPooledSize && alignof(T) <= kAlign;
+
+public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  PoolAllocator() = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& tmp) {
+    std::ignore = tmp;
+  }
+
+  template <typename U>
+  PoolAllocator(const std::allocator<U>& tmp) {
+    std::ignore = tmp;
+  }
+
+  T* allocate(size_t count) {
+    if constexpr (kPooled) {
+      if (count == 1) {
+        return static_cast<T*>(ControlBlockPool<kSizeClass>::allocate());
+      }
+    }
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    if constexpr (kPooled) {
+      if (count == 1) {
+        ControlBlockPool<kSizeClass>::deallocate(ptr);
+        return;
+      }
+    }
+    std::allocator<T>().deallocate(ptr, count);
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+// Control blocks requested through std::allocator are served by the pool instead.
+template<typename Alloc>
+struct ControlBlockAllocator {
+  using type = Alloc;
+};
+
+template<typename T>
+struct ControlBlockAllocator<std::allocator<T>> {
+  using type = PoolAllocator<T>;
+};
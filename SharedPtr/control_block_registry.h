@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Registry of live control blocks for chasing leaks, compiled in with SHARED_PTR_TRACK_BLOCKS.
+// Without it BaseControlBlock carries no extra field, nothing is registered and snapshot() is empty.
+//
+// Each block gets a node with its type, allocation site and birth time. Nodes are pushed lock-free
+// onto one of kShards lists, picked per thread; a dying block marks its node dead under the shard
+// mutex, which is also what snapshot() holds while it reads counts, so a block is never read after
+// it is freed. Dead nodes are unlinked in batches once they make up half a shard.
+//
+// The allocation site is whatever Site is active on the creating thread:
+//   ControlBlockRegistry::Site site;  // tags blocks created in this scope with this file and line
+class ControlBlockRegistry {
+public:
+#ifdef SHARED_PTR_TRACK_BLOCKS
+  static constexpr bool kEnabled = true;
+#else
+  static constexpr bool kEnabled = false;
+#endif
+
+  struct BlockInfo {
+    const void* block;
+    std::string_view type_name;
+    const char* file;
+    unsigned line;
+    size_t use_count;
+    size_t weak_count;
+    std::chrono::nanoseconds age;
+
+    // Alive only because of WeakPtrs: the object is gone but the block (and, for makeShared, the
+    // object's storage) is still held.
+    bool weak_only() const { return use_count == 0; }
+  };
+
+  class Site {
+  private:
+    std::source_location where_;
+    const Site* previous_;
+
+  public:
+    explicit Site(std::source_location where = std::source_location::current())
+        : where_(where), previous_(CurrentSite()) {
+      CurrentSite() = this;
+    }
+
+    Site(const Site& tmp) = delete;
+    Site& operator=(const Site& tmp) = delete;
+
+    ~Site() { CurrentSite() = previous_; }
+
+    const std::source_location& where() const { return where_; }
+  };
+
+  static size_t live();
+  static std::vector<BlockInfo> snapshot();
+  // Blocks alive only through weak references that are at least min_age old.
+  static std::vector<BlockInfo> weak_only(std::chrono::nanoseconds min_age = std::chrono::nanoseconds(0));
+  static void dump(std::ostream& out);
+
+private:
+  friend struct BaseControlBlock;
+
+  struct Node {
+    const void* block;
+    void (*counts)(const void* block, size_t& shared, size_t& weak);
+    std::string_view type;
+    const char* file;
+    unsigned line;
+    std::chrono::steady_clock::time_point born;
+    size_t shard;
+    Node* next;
+  };
+
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kSweepMin = 64;
+
+  struct alignas(64) Shard {
+    std::atomic<Node*> head{nullptr};
+    std::atomic<size_t> total{0};
+    size_t dead = 0;
+    std::mutex mutex;
+  };
+
+  // Never destroyed: blocks can die during static destruction.
+  static Shard* Shards() {
+    static Shard* shards = new Shard[kShards];
+    return shards;
+  }
+
+  static const Site*& CurrentSite() {
+    thread_local const Site* site = nullptr;
+    return site;
+  }
+
+  static size_t ShardIndex() {
+    thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kShards;
+    return index;
+  }
+
+  template <typename T>
+  static std::string_view TypeName();
+
+  template <typename Block>
+  static void Counts(const void* block, size_t& shared, size_t& weak) {
+    const Block* cb = static_cast<const Block*>(block);
+    shared = cb->GiveShared();
+    weak = cb->GiveWeak();
+  }
+
+  template <typename T, typename Block>
+  static Node* Track(const Block* block);
+
+  static void Untrack(Node* node);
+  static void Sweep(Shard& shard);
+  static void Collect(Shard& shard, std::chrono::steady_clock::time_point now, std::vector<BlockInfo>& out);
+};
+
+// Cut out of the compiler's own spelling of this function, so it needs no RTTI.
+template <typename T>
+std::string_view ControlBlockRegistry::TypeName() {
+  std::string_view name = __PRETTY_FUNCTION__;
+  size_t start = name.find("T = ");
+  if (start == std::string_view::npos) {
+    return name;
+  }
+  start += 4;
+  size_t end = name.find(';', start);
+  if (end == std::string_view::npos) {
+    end = name.rfind(']');
+  }
+  return name.substr(start, end - start);
+}
+
+template <typename T, typename Block>
+ControlBlockRegistry::Node* ControlBlockRegistry::Track(const Block* block) {
+  const Site* site = CurrentSite();
+  size_t index = ShardIndex();
+  Node* node = new Node{block, &Counts<Block>, TypeName<T>(), site == nullptr ? nullptr : site->where().file_name(),
+                        site == nullptr ? 0 : static_cast<unsigned>(site->where().line()),
+                        std::chrono::steady_clock::now(), index, nullptr};
+  Shard& shard = Shards()[index];
+  shard.total.fetch_add(1, std::memory_order_relaxed);
+  Node* head = shard.head.load(std::memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!shard.head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+  return node;
+}
+
+inline void ControlBlockRegistry::Untrack(Node* node) {
+  if (node == nullptr) {
+    return;
+  }
+  Shard& shard = Shards()[node->shard];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  node->block = nullptr;
+  if (++shard.dead >= kSweepMin && shard.dead * 2 >= shard.total.load(std::memory_order_relaxed)) {
+    Sweep(shard);
+  }
+}
+
+// Called with shard.mutex held. Pushers only ever swing the head, so everything behind it can be
+// unlinked here; a dead head is left for the next sweep.
+inline void ControlBlockRegistry::Sweep(Shard& shard) {
+  Node* prev = shard.head.load(std::memory_order_acquire);
+  if (prev == nullptr) {
+    return;
+  }
+  size_t freed = 0;
+  for (Node* node = prev->next; node != nullptr; node = prev->next) {
+    if (node->block == nullptr) {
+      prev->next = node->next;
+      delete node;
+      ++freed;
+    } else {
+      prev = node;
+    }
+  }
+  shard.dead -= freed;
+  shard.total.fetch_sub(freed, std::memory_order_relaxed);
+}
+
+// Called with shard.mutex held.
+inline void ControlBlockRegistry::Collect(Shard& shard, std::chrono::steady_clock::time_point now,
+                                          std::vector<BlockInfo>& out) {
+  for (Node* node = shard.head.load(std::memory_order_acquire); node != nullptr; node = node->next) {
+    if (node->block == nullptr) {
+      continue;
+    }
+    size_t shared = 0;
+    size_t weak = 0;
+    node->counts(node->block, shared, weak);
+    out.push_back(BlockInfo{node->block, node->type, node->file, node->line, shared, weak,
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(now - node->born)});
+  }
+}
+
+inline size_t ControlBlockRegistry::live() {
+  size_t count = 0;
+  if constexpr (kEnabled) {
+    Shard* shards = Shards();
+    for (size_t i = 0; i < kShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      count += shards[i].total.load(std::memory_order_relaxed) - shards[i].dead;
+    }
+  }
+  return count;
+}
+
+inline std::vector<ControlBlockRegistry::BlockInfo> ControlBlockRegistry::snapshot() {
+  std::vector<BlockInfo> out;
+  if constexpr (kEnabled) {
+    auto now = std::chrono::steady_clock::now();
+    Shard* shards = Shards();
+    for (size_t i = 0; i < kShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      Collect(shards[i], now, out);
+    }
+  }
+  return out;
+}
+
+inline std::vector<ControlBlockRegistry::BlockInfo> ControlBlockRegistry::weak_only(std::chrono::nanoseconds min_age) {
+  std::vector<BlockInfo> out;
+  for (const BlockInfo& info : snapshot()) {
+    if (info.weak_only() && info.age >= min_age) {
+      out.push_back(info);
+    }
+  }
+  return out;
+}
+
+inline void ControlBlockRegistry::dump(std::ostream& out) {
+  std::vector<BlockInfo> blocks = snapshot();
+  out << blocks.size() << " live control blocks\n";
+  for (const BlockInfo& info : blocks) {
+    out << info.block << ' ' << info.type_name << " shared=" << info.use_count << " weak=" << info.weak_count
+        << " age=" << std::chrono::duration_cast<std::chrono::milliseconds>(info.age).count() << "ms";
+    if (info.file != nullptr) {
+      out << " at " << info.file << ':' << info.line;
+    }
+    if (info.weak_only()) {
+      out << " [weak only]";
+    }
+    out << '\n';
+  }
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "shared_ptr.h"
+
+// Epoch-based reclamation for lock-free readers. A reader pins the current global epoch with a Guard
+// and may then follow raw pointers (SharedPtr::get() of nodes it found through the structure)
+// without touching any reference count. A writer that unlinks a node hands its SharedPtr to retire();
+// the reference is dropped only once every thread has unpinned the epoch it was retired in, so the
+// object outlives every traversal that could still reach it.
+//
+// The epoch advances when every pinned thread has caught up with it; a reference retired in epoch e
+// is released once the global epoch reaches e + 2. Threads that exit hand what they still hold to a
+// shared list that the next collect() on any thread picks up.
+class EpochDomain {
+public:
+  class Guard {
+  public:
+    Guard() { Pin(); }
+
+    Guard(const Guard& tmp) = delete;
+    Guard& operator=(const Guard& tmp) = delete;
+
+    ~Guard() { Unpin(); }
+  };
+
+  template <typename T>
+  static void retire(SharedPtr<T> ptr);
+
+  template <typename T>
+  static void retire(T* ptr);
+
+  // Tries to advance the epoch and releases whatever has become safe. Returns how many were released.
+  static size_t collect();
+
+  static size_t pending() { return LocalGone() ? 0 : LocalRetired().items.size(); }
+
+private:
+  static constexpr size_t kCollectThreshold = 64;
+
+  struct Record {
+    // 0 while the thread is not inside a Guard, the pinned epoch otherwise.
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> used{true};
+    Record* next = nullptr;
+  };
+
+  struct Retired {
+    uint64_t epoch;
+    void* object;
+    void (*release)(void*);
+  };
+
+  struct Global {
+    std::atomic<uint64_t> epoch{1};
+    std::atomic<Record*> records{nullptr};
+    std::mutex mutex;
+    std::vector<Retired> orphans;
+  };
+
+  struct Local {
+    std::vector<Retired> items;
+    ~Local();
+  };
+
+  // Gives the thread's record back at thread exit, whether or not the thread ever retired anything.
+  struct RecordOwner {
+    ~RecordOwner();
+  };
+
+  // Never destroyed, so threads exiting after static destruction still find their records.
+  static Global& GetGlobal() {
+    static Global* global = new Global;
+    return *global;
+  }
+
+  // Trivially destructible, so Guards used during thread teardown keep working.
+  static Record*& CurrentRecord() {
+    thread_local Record* record = nullptr;
+    return record;
+  }
+
+  static unsigned& Depth() {
+    thread_local unsigned depth = 0;
+    return depth;
+  }
+
+  static bool& LocalGone() {
+    thread_local bool gone = false;
+    return gone;
+  }
+
+  // Set once RecordOwner is destroyed; Guards after that return their record when they unpin.
+  static bool& OwnerGone() {
+    thread_local bool gone = false;
+    return gone;
+  }
+
+  static void HoldRecord() {
+    thread_local RecordOwner owner;
+    std::ignore = owner;
+  }
+
+  static Local& LocalRetired() {
+    thread_local Local local;
+    return local;
+  }
+
+  static void Pin();
+  static void Unpin();
+  static Record* AcquireRecord();
+  static void ReleaseRecord();
+  static uint64_t TryAdvance();
+  static void Push(Retired item);
+  static size_t ReleaseReady(std::vector<Retired>& items, uint64_t epoch);
+
+  static void ReleaseBlock(void* cb) {
+    static_cast<BaseControlBlock*>(cb)->Shared_TryToDeleteThisOne();
+  }
+
+  template <typename T>
+  static void DeleteObject(void* ptr) {
+    delete static_cast<T*>(ptr);
+  }
+};
+
+template <typename T>
+void EpochDomain::retire(SharedPtr<T> ptr) {
+  BaseControlBlock* cb = ptr.cb;
+  if (cb == nullptr) {
+    return;
+  }
+  ptr.cb = nullptr;
+  ptr.ptr = nullptr;
+  Push(Retired{GetGlobal().epoch.load(std::memory_order_seq_cst), cb, &ReleaseBlock});
+}
+
+template <typename T>
+void EpochDomain::retire(T* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  Push(Retired{GetGlobal().epoch.load(std::memory_order_seq_cst), ptr, &DeleteObject<T>});
+}
+
+// Records are reused by later threads rather than freed, so the list only ever grows at the head.
+inline EpochDomain::Record* EpochDomain::AcquireRecord() {
+  Global& global = GetGlobal();
+  for (Record* record = global.records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+    bool used = false;
+    if (!record->used.load(std::memory_order_relaxed) &&
+        record->used.compare_exchange_strong(used, true, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return record;
+    }
+  }
+  Record* record = new Record;
+  Record* head = global.records.load(std::memory_order_relaxed);
+  do {
+    record->next = head;
+  } while (!global.records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+  return record;
+}
+
+// The epoch is re-read after publishing it, so a collector that missed the pin cannot have moved on
+// twice and freed something this reader is about to see.
+inline void EpochDomain::Pin() {
+  if (Depth()++ != 0) {
+    return;
+  }
+  Record*& record = CurrentRecord();
+  if (record == nullptr) {
+    record = AcquireRecord();
+    if (!OwnerGone()) {
+      HoldRecord();
+    }
+  }
+  Global& global = GetGlobal();
+  uint64_t epoch = global.epoch.load(std::memory_order_seq_cst);
+  while (true) {
+    record->epoch.store(epoch, std::memory_order_seq_cst);
+    uint64_t now = global.epoch.load(std::memory_order_seq_cst);
+    if (now == epoch) {
+      return;
+    }
+    epoch = now;
+  }
+}
+
+inline void EpochDomain::Unpin() {
+  if (--Depth() == 0) {
+    CurrentRecord()->epoch.store(0, std::memory_order_release);
+    if (OwnerGone()) {
+      ReleaseRecord();
+    }
+  }
+}
+
+inline void EpochDomain::ReleaseRecord() {
+  Record* record = CurrentRecord();
+  if (record != nullptr && Depth() == 0) {
+    CurrentRecord() = nullptr;
+    record->used.store(false, std::memory_order_release);
+  }
+}
+
+inline uint64_t EpochDomain::TryAdvance() {
+  Global& global = GetGlobal();
+  uint64_t epoch = global.epoch.load(std::memory_order_seq_cst);
+  for (Record* record = global.records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+    uint64_t pinned = record->epoch.load(std::memory_order_seq_cst);
+    if (pinned != 0 && pinned != epoch) {
+      return epoch;
+    }
+  }
+  if (global.epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst)) {
+    return epoch + 1;
+  }
+  return epoch;
+}
+
+// Released items may retire more, so the ready ones are taken out before any is released.
+inline size_t EpochDomain::ReleaseReady(std::vector<Retired>& items, uint64_t epoch) {
+  std::vector<Retired> ready;
+  size_t kept = 0;
+  for (const Retired& item : items) {
+    if (item.epoch + 2 <= epoch) {
+      ready.push_back(item);
+    } else {
+      items[kept++] = item;
+    }
+  }
+  items.resize(kept);
+  for (const Retired& item : ready) {
+    item.release(item.object);
+  }
+  return ready.size();
+}
+
+inline size_t EpochDomain::collect() {
+  uint64_t epoch = TryAdvance();
+  size_t count = 0;
+  Global& global = GetGlobal();
+  std::vector<Retired> orphans;
+  {
+    std::lock_guard<std::mutex> lock(global.mutex);
+    orphans.swap(global.orphans);
+  }
+  if (!orphans.empty()) {
+    count += ReleaseReady(orphans, epoch);
+    std::lock_guard<std::mutex> lock(global.mutex);
+    global.orphans.insert(global.orphans.end(), orphans.begin(), orphans.end());
+  }
+  if (!LocalGone()) {
+    count += ReleaseReady(LocalRetired().items, epoch);
+  }
+  return count;
+}
+
+inline void EpochDomain::Push(Retired item) {
+  if (LocalGone()) {
+    Global& global = GetGlobal();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    global.orphans.push_back(item);
+    return;
+  }
+  Local& local = LocalRetired();
+  local.items.push_back(item);
+  if (local.items.size() % kCollectThreshold == 0) {
+    collect();
+  }
+}
+
+inline EpochDomain::Local::~Local() {
+  LocalGone() = true;
+  Global& global = GetGlobal();
+  {
+    std::lock_guard<std::mutex> lock(global.mutex);
+    global.orphans.insert(global.orphans.end(), items.begin(), items.end());
+  }
+  items.clear();
+}
+
+inline EpochDomain::RecordOwner::~RecordOwner() {
+  OwnerGone() = true;
+  ReleaseRecord();
+}
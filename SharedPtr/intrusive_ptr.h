@@ -0,0 +1,182 @@
+#pragma once
+
+#include <utility>
+#include "shared_ptr.h"
+
+template <typename T>
+class IntrusivePtr;
+
+// CRTP base that keeps the reference count inside the object: class Foo : public RefCounted<Foo>.
+// With a non-default Policy only the bare counter is embedded and the object can be shared through
+// IntrusivePtr alone.
+template <typename T, typename Policy = SharedPtrCountPolicy>
+class RefCounted {
+private:
+  template <typename U>
+  friend class IntrusivePtr;
+
+  static constexpr bool kAdoptable = false;
+
+  mutable typename Policy::Counter refs_;
+
+  void AddRef() const { Policy::Increment(refs_); }
+
+  void Release() const {
+    if (Policy::Decrement(refs_)) {
+      delete static_cast<const T*>(this);
+    }
+  }
+
+  size_t UseCount() const { return Policy::Load(refs_); }
+
+protected:
+  RefCounted(): refs_(0) {}
+
+  RefCounted(const RefCounted& tmp): refs_(0) {
+    std::ignore = tmp;
+  }
+
+  RefCounted& operator=(const RefCounted& tmp) {
+    std::ignore = tmp;
+    return *this;
+  }
+
+  ~RefCounted() = default;
+};
+
+// With SharedPtr's own policy the object embeds a whole control block, so IntrusivePtr::to_shared can
+// hand it to SharedPtr without allocating. The object is deleted once the last SharedPtr, IntrusivePtr
+// and WeakPtr are gone; a WeakPtr to it reports expired as soon as the last strong reference goes.
+template <typename T>
+class RefCounted<T, SharedPtrCountPolicy>: private BaseControlBlock {
+private:
+  template <typename U>
+  friend class IntrusivePtr;
+
+  static constexpr bool kAdoptable = true;
+
+  static const void* Hook(BaseControlBlock* base, Operation op) {
+    if (op == Operation::Clean) {
+      delete static_cast<const T*>(static_cast<RefCounted*>(base));
+    }
+    return nullptr;
+  }
+
+  BaseControlBlock* Block() const { return const_cast<BaseControlBlock*>(static_cast<const BaseControlBlock*>(this)); }
+  void AddRef() const { Block()->IncreaseShared(); }
+  void Release() const { Block()->Shared_TryToDeleteThisOne(); }
+  size_t UseCount() const { return GiveShared(); }
+
+protected:
+  RefCounted(): BaseControlBlock(0, 1, &Hook) {
+    Track<T>();
+  }
+
+  RefCounted(const RefCounted& tmp): BaseControlBlock(0, 1, &Hook) {
+    std::ignore = tmp;
+    Track<T>();
+  }
+
+  RefCounted& operator=(const RefCounted& tmp) {
+    std::ignore = tmp;
+    return *this;
+  }
+
+  // An object destroyed without ever being shared (on the stack, or deleted directly) never reaches Clean.
+  ~RefCounted() {
+    Untrack();
+  }
+};
+
+// One-pointer handle to a RefCounted object.
+template <typename T>
+class IntrusivePtr {
+private:
+  template <typename U>
+  friend class IntrusivePtr;
+
+  T* ptr_;
+
+public:
+  IntrusivePtr(): ptr_(nullptr) {}
+
+  explicit IntrusivePtr(T* tmp): ptr_(tmp) {
+    if (ptr_ != nullptr) {
+      ptr_->AddRef();
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr& tmp): IntrusivePtr(tmp.ptr_) {}
+
+  IntrusivePtr(IntrusivePtr&& tmp) noexcept: ptr_(tmp.ptr_) {
+    tmp.ptr_ = nullptr;
+  }
+
+  template <typename U, std::enable_if_t<check<T, U>::value || std::is_same_v<T, const U>, int> = 0>
+  IntrusivePtr(const IntrusivePtr<U>& tmp): IntrusivePtr(static_cast<T*>(tmp.ptr_)) {}
+
+  template <typename U, std::enable_if_t<check<T, U>::value || std::is_same_v<T, const U>, int> = 0>
+  IntrusivePtr(IntrusivePtr<U>&& tmp) noexcept: ptr_(static_cast<T*>(tmp.ptr_)) {
+    tmp.ptr_ = nullptr;
+  }
+
+  IntrusivePtr& operator=(const IntrusivePtr& tmp) {
+    IntrusivePtr(tmp).swap(*this);
+    return *this;
+  }
+
+  IntrusivePtr& operator=(IntrusivePtr&& tmp) noexcept {
+    IntrusivePtr(std::move(tmp)).swap(*this);
+    return *this;
+  }
+
+  void reset() {
+    IntrusivePtr().swap(*this);
+  }
+
+  void reset(T* tmp) {
+    IntrusivePtr(tmp).swap(*this);
+  }
+
+  void swap(IntrusivePtr& tmp) noexcept {
+    std::swap(ptr_, tmp.ptr_);
+  }
+
+  T* get() const noexcept { return ptr_; }
+  T& operator*() const noexcept { return *ptr_; }
+  T* operator->() const noexcept { return ptr_; }
+
+  explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+  size_t use_count() const { return ptr_ == nullptr ? 0 : ptr_->UseCount(); }
+
+  // Shares the object with SharedPtr through its embedded control block; no allocation.
+  SharedPtr<T> to_shared() const {
+    static_assert(std::remove_cv_t<T>::kAdoptable, "to_shared needs RefCounted with SharedPtr's count policy");
+    if (ptr_ == nullptr) {
+      return SharedPtr<T>();
+    }
+    return SharedPtr<T>(ptr_->Block(), ptr_);
+  }
+
+  ~IntrusivePtr() {
+    if (ptr_ != nullptr) {
+      ptr_->Release();
+    }
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const IntrusivePtr<T>& left, const IntrusivePtr<U>& right) {
+  return left.get() == right.get();
+}
+
+template <typename T, typename U>
+bool operator!=(const IntrusivePtr<T>& left, const IntrusivePtr<U>& right) {
+  return left.get() != right.get();
+}
+
+template <typename T, typename... Args>
+IntrusivePtr<T> makeIntrusive(Args&&... args) {
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
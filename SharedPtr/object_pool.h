@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "shared_ptr.h"
+
+// Pool of reusable T. acquire() hands out a SharedPtr whose deleter gives the object back instead of
+// destroying it, after running the optional reset hook; the control block comes from the same
+// per-thread ControlBlockPool every std::allocator-backed SharedPtr uses, so a warm acquire/release
+// pair allocates nothing. An object whose reset hook throws is deleted rather than recycled.
+//
+// Released objects go to the releasing thread's cache, which spills into and refills from a shared
+// list. At most max_size objects sit idle across all of them; the rest are deleted on release. Objects
+// released after the pool is destroyed are deleted, and a thread's cache is returned when it exits.
+//
+// The shared state is counted by the pool, every handed-out object and every thread cache. Threads
+// borrow references and idle slots in batches, so a warm acquire/release pair touches no shared atomic.
+template<typename T>
+class ObjectPool {
+public:
+  using Reset = std::function<void(T&)>;
+
+  explicit ObjectPool(size_t max_size, Reset reset = Reset());
+
+  ObjectPool(const ObjectPool& tmp) = delete;
+  ObjectPool& operator=(const ObjectPool& tmp) = delete;
+
+  SharedPtr<T> acquire();
+
+  // Idle objects plus the slots thread caches have set aside for more; never above max_size.
+  size_t idle() const { return state_->idle.load(std::memory_order_relaxed); }
+  size_t max_size() const { return state_->maxSize; }
+
+  ~ObjectPool();
+
+private:
+  static constexpr size_t kCacheLimit = 32;
+  static constexpr size_t kBatch = kCacheLimit / 2;
+
+  struct State {
+    std::mutex mutex;
+    std::vector<T*> shared;
+    // shared.size() plus, for every thread cache, its objects and its unused slots.
+    std::atomic<size_t> idle{0};
+    std::atomic<size_t> refs{1};
+    std::atomic<bool> closed{false};
+    size_t maxSize;
+    Reset reset;
+
+    State(size_t max_size, Reset reset) : maxSize(max_size), reset(std::move(reset)) {}
+  };
+
+  // A list holds at least one reference to its state while it is in the cache; the others are spares
+  // handed to acquired objects and taken back from released ones.
+  struct LocalList {
+    State* state;
+    std::vector<T*> objects;
+    size_t slots;
+    size_t refs;
+  };
+
+  // One list per pool this thread has touched; there are rarely more than a handful.
+  struct Cache {
+    std::vector<LocalList> lists;
+    ~Cache();
+  };
+
+  struct Recycler {
+    State* state;
+
+    void operator()(T* ptr) const {
+      Recycle(state, ptr);
+    }
+  };
+
+  State* state_;
+
+  static Cache& GetCache() {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  static bool& CacheGone() {
+    thread_local bool gone = false;
+    return gone;
+  }
+
+  static LocalList* LocalFor(State* state);
+  static T* Take(State* state);
+  static bool Keep(State* state, T* ptr);
+  static void Recycle(State* state, T* ptr);
+  static void GiveBack(State& state, std::vector<T*>& objects, size_t count);
+  static void Drop(LocalList& list);
+  static void Unref(State* state, size_t count);
+};
+
+template<typename T>
+ObjectPool<T>::ObjectPool(size_t max_size, Reset reset) : state_(new State(max_size, std::move(reset))) {}
+
+template<typename T>
+SharedPtr<T> ObjectPool<T>::acquire() {
+  T* ptr = Take(state_);
+  if (ptr == nullptr) {
+    ptr = new T();
+  }
+  // The object carries one reference to the state, so a release after the pool is gone is still safe.
+  LocalList* list = LocalFor(state_);
+  if (list == nullptr) {
+    state_->refs.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    if (list->refs == 1) {
+      state_->refs.fetch_add(kBatch, std::memory_order_relaxed);
+      list->refs += kBatch;
+    }
+    --list->refs;
+  }
+  try {
+    return SharedPtr<T>(ptr, Recycler{state_});
+  } catch (...) {
+    Recycle(state_, ptr);
+    throw;
+  }
+}
+
+template<typename T>
+ObjectPool<T>::~ObjectPool() {
+  State* state = state_;
+  state->closed.store(true, std::memory_order_release);
+  std::vector<T*> objects;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    objects.swap(state->shared);
+  }
+  state->idle.fetch_sub(objects.size(), std::memory_order_relaxed);
+  for (T* ptr : objects) {
+    delete ptr;
+  }
+  if (!CacheGone()) {
+    std::vector<LocalList>& lists = GetCache().lists;
+    for (size_t i = 0; i < lists.size(); ++i) {
+      if (lists[i].state == state) {
+        LocalList list = std::move(lists[i]);
+        lists.erase(lists.begin() + i);
+        Drop(list);
+        break;
+      }
+    }
+  }
+  Unref(state, 1);
+}
+
+// Null once the thread's cache is gone; such a thread works on the shared list directly. Lists of
+// pools destroyed on other threads are dropped on the way. The caller must hold a reference to state.
+template<typename T>
+typename ObjectPool<T>::LocalList* ObjectPool<T>::LocalFor(State* state) {
+  if (CacheGone()) {
+    return nullptr;
+  }
+  std::vector<LocalList>& lists = GetCache().lists;
+  for (size_t i = 0; i < lists.size();) {
+    if (lists[i].state == state) {
+      return &lists[i];
+    }
+    if (lists[i].state->closed.load(std::memory_order_acquire)) {
+      LocalList list = std::move(lists[i]);
+      lists.erase(lists.begin() + i);
+      Drop(list);
+    } else {
+      ++i;
+    }
+  }
+  state->refs.fetch_add(1, std::memory_order_relaxed);
+  lists.push_back(LocalList{state, {}, 0, 1});
+  return &lists.back();
+}
+
+template<typename T>
+T* ObjectPool<T>::Take(State* state) {
+  LocalList* list = LocalFor(state);
+  if (list == nullptr || list->objects.empty()) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->shared.empty()) {
+      return nullptr;
+    }
+    if (list == nullptr) {
+      T* ptr = state->shared.back();
+      state->shared.pop_back();
+      state->idle.fetch_sub(1, std::memory_order_relaxed);
+      return ptr;
+    }
+    size_t count = std::min(kBatch, state->shared.size());
+    list->objects.insert(list->objects.end(), state->shared.end() - count, state->shared.end());
+    state->shared.resize(state->shared.size() - count);
+  }
+  T* ptr = list->objects.back();
+  list->objects.pop_back();
+  if (++list->slots > kCacheLimit) {
+    state->idle.fetch_sub(kBatch, std::memory_order_relaxed);
+    list->slots -= kBatch;
+  }
+  return ptr;
+}
+
+// Files ptr as idle, reserving up to kBatch slots at once for this thread. False if the pool is full.
+template<typename T>
+bool ObjectPool<T>::Keep(State* state, T* ptr) {
+  LocalList* list = LocalFor(state);
+  if (list == nullptr || list->slots == 0) {
+    size_t want = (list == nullptr ? 1 : kBatch);
+    size_t idle = state->idle.load(std::memory_order_relaxed);
+    size_t grant;
+    do {
+      if (idle >= state->maxSize) {
+        return false;
+      }
+      grant = std::min(want, state->maxSize - idle);
+    } while (!state->idle.compare_exchange_weak(idle, idle + grant, std::memory_order_relaxed));
+    if (list == nullptr) {
+      std::vector<T*> single{ptr};
+      GiveBack(*state, single, 1);
+      return true;
+    }
+    list->slots = grant;
+  }
+  list->objects.push_back(ptr);
+  --list->slots;
+  if (list->objects.size() > kCacheLimit) {
+    GiveBack(*state, list->objects, kBatch);
+  }
+  return true;
+}
+
+// Runs as a deleter, so nothing may escape.
+template<typename T>
+void ObjectPool<T>::Recycle(State* state, T* ptr) {
+  bool keep = !state->closed.load(std::memory_order_acquire);
+  if (keep && state->reset) {
+    try {
+      state->reset(*ptr);
+    } catch (...) {
+      keep = false;
+    }
+  }
+  try {
+    keep = keep && Keep(state, ptr);
+  } catch (...) {
+    keep = false;
+  }
+  LocalList* list = LocalFor(state);
+  if (list == nullptr) {
+    Unref(state, 1);
+  } else if (++list->refs > 2 * kBatch) {
+    list->refs -= kBatch;
+    Unref(state, kBatch);
+  }
+  if (!keep) {
+    delete ptr;
+  }
+}
+
+// Moves the last count objects to the shared list, or deletes them once the pool is gone.
+template<typename T>
+void ObjectPool<T>::GiveBack(State& state, std::vector<T*>& objects, size_t count) {
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.closed.load(std::memory_order_acquire)) {
+      state.shared.insert(state.shared.end(), objects.end() - count, objects.end());
+      objects.resize(objects.size() - count);
+      return;
+    }
+  }
+  state.idle.fetch_sub(count, std::memory_order_relaxed);
+  std::vector<T*> doomed(objects.end() - count, objects.end());
+  objects.resize(objects.size() - count);
+  for (T* ptr : doomed) {
+    delete ptr;
+  }
+}
+
+// Returns everything a list holds: objects, unused slots and references. list is already out of the cache.
+template<typename T>
+void ObjectPool<T>::Drop(LocalList& list) {
+  GiveBack(*list.state, list.objects, list.objects.size());
+  list.state->idle.fetch_sub(list.slots, std::memory_order_relaxed);
+  Unref(list.state, list.refs);
+}
+
+template<typename T>
+void ObjectPool<T>::Unref(State* state, size_t count) {
+  if (state->refs.fetch_sub(count, std::memory_order_acq_rel) == count) {
+    delete state;
+  }
+}
+
+template<typename T>
+ObjectPool<T>::Cache::~Cache() {
+  CacheGone() = true;
+  for (LocalList& list : lists) {
+    Drop(list);
+  }
+}
@@ -1,49 +1,636 @@
+#pragma once
+
 #include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <iostream>
+#include "control_block_pool.h"
+#include "control_block_registry.h"
 
 template<typename T, typename U>
 struct check {
   static const bool value = std::is_base_of_v<T, U> || std::is_same_v<T, U>;
 };
 
+// Raw pointers adopted by SharedPtr<T[]> / SharedPtr<T[N]> point at the first element.
+template<typename T, typename U>
+struct check_pointer {
+  static const bool value = check<T, U>::value || (std::is_array_v<T> && std::is_same_v<std::remove_extent_t<T>, U>);
+};
+
 template <typename T>
 class EnableSharedFromThis;
 
 template<typename T>
 class WeakPtr;
 
+// SHARED_PTR_32BIT_COUNTS shrinks both counters of every control block to 32 bits, for programs that
+// keep very many small shared objects; more than 2^32 - 1 owners of one object is then undefined.
+#ifdef SHARED_PTR_32BIT_COUNTS
+using SharedPtrCount = uint32_t;
+#else
+using SharedPtrCount = size_t;
+#endif
+
+// Plain counters, as cheap as the original ++/--. Only safe while every owner lives on one thread.
+struct NonAtomicCountPolicy {
+  using Counter = SharedPtrCount;
+  using WeakPolicy = NonAtomicCountPolicy;
+
+  static void Increment(Counter& count) { ++count; }
+  static bool Decrement(Counter& count) { return --count == 0; }
+
+  static bool IncrementIfNonZero(Counter& count) {
+    if (count == 0) {
+      return false;
+    }
+    ++count;
+    return true;
+  }
+
+  static size_t Load(const Counter& count) { return count; }
+};
+
+// Increments are relaxed: a new owner can only come from an existing one. The release decrement
+// plus an acquire re-load on the zero path (which reads the end of the release sequence, and unlike
+// a standalone fence is understood by ThreadSanitizer) orders every owner's writes before destruction.
+struct AtomicCountPolicy {
+  using Counter = std::atomic<SharedPtrCount>;
+  using WeakPolicy = AtomicCountPolicy;
+
+  static void Increment(Counter& count) { count.fetch_add(1, std::memory_order_relaxed); }
+
+  static bool Decrement(Counter& count) {
+    if (count.fetch_sub(1, std::memory_order_release) == 1) {
+      count.load(std::memory_order_acquire);
+      return true;
+    }
+    return false;
+  }
+
+  // For WeakPtr::lock: once the count has reached zero it must never come back.
+  static bool IncrementIfNonZero(Counter& count) {
+    SharedPtrCount old = count.load(std::memory_order_relaxed);
+    do {
+      if (old == 0) {
+        return false;
+      }
+    } while (!count.compare_exchange_weak(old, old + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+    return true;
+  }
+
+  static size_t Load(const Counter& count) { return count.load(std::memory_order_relaxed); }
+};
+
+// Biased reference counting for shared counts (weak counts stay atomic). The thread that creates a
+// block owns it and counts with plain loads and stores; every other thread uses an atomic counter that
+// may go negative. The real count is the sum of both, so only a merge can observe zero:
+//  - when the owner's count reaches zero it folds itself into the atomic counter and marks it merged;
+//    from then on everybody, the owner included, counts atomically;
+//  - when another thread first drives the atomic counter negative it queues the block on the owner,
+//    which merges it on its next release, on flush(), or at thread exit, whichever comes first;
+//    a block whose owner has already exited is merged on the spot.
+// The first reference to a block must be taken on the thread that created it, which holds for every
+// way SharedPtr, makeShared and IntrusivePtr create one.
+class BiasedCountPolicy {
+private:
+  static constexpr intptr_t kMerged = 1;
+  static constexpr intptr_t kQueued = 2;
+  static constexpr int kShift = 2;
+  static constexpr intptr_t kUnit = intptr_t(1) << kShift;
+
+  struct Pending {
+    void* block;
+    void (*merge)(void*);
+  };
+
+  struct Owner {
+    std::atomic<size_t> refs{1};
+    std::atomic<bool> pending{false};
+    std::mutex mutex;
+    std::vector<Pending> queue;
+    bool exited = false;
+  };
+
+  struct Guard {
+    ~Guard() {
+      Exit();
+    }
+  };
+
+  // Plain pointers, so they stay readable while the thread's other thread_locals are torn down.
+  static Owner*& Current() {
+    thread_local Owner* current = nullptr;
+    return current;
+  }
+
+  static bool& Exited() {
+    thread_local bool exited = false;
+    return exited;
+  }
+
+  static Owner* CurrentOwner() {
+    Owner* current = Current();
+    if (current == nullptr && !Exited()) {
+      current = new Owner;
+      Current() = current;
+      thread_local Guard guard;
+    }
+    return current;
+  }
+
+  static void ReleaseOwner(Owner* owner) {
+    if (owner != nullptr && owner->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete owner;
+    }
+  }
+
+  static void Exit();
+
+public:
+  using WeakPolicy = AtomicCountPolicy;
+
+  struct Counter {
+    Owner* owner;
+    std::atomic<size_t> biased;
+    std::atomic<intptr_t> shared;
+    bool merged;
+
+    // A block born while its thread is being torn down has no owner and starts out merged.
+    Counter(size_t initial): owner(CurrentOwner()), biased(0), shared(0), merged(owner == nullptr) {
+      if (merged) {
+        shared.store(static_cast<intptr_t>(initial) * kUnit + kMerged, std::memory_order_relaxed);
+      } else {
+        owner->refs.fetch_add(1, std::memory_order_relaxed);
+        biased.store(initial, std::memory_order_relaxed);
+      }
+    }
+
+    Counter(const Counter& tmp) = delete;
+    Counter& operator=(const Counter& tmp) = delete;
+
+    ~Counter() {
+      ReleaseOwner(owner);
+    }
+  };
+
+  static void Increment(Counter& count) {
+    if (count.owner == Current() && !count.merged) {
+      count.biased.store(count.biased.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+      count.shared.fetch_add(kUnit, std::memory_order_relaxed);
+    }
+  }
+
+  template <typename Block>
+  static bool Decrement(Counter& count, Block* block);
+
+  static bool IncrementIfNonZero(Counter& count);
+
+  static size_t Load(const Counter& count) {
+    intptr_t total = static_cast<intptr_t>(count.biased.load(std::memory_order_relaxed))
+                   + (count.shared.load(std::memory_order_relaxed) >> kShift);
+    return total < 0 ? 0 : static_cast<size_t>(total);
+  }
+
+  // Merges every block other threads have queued on the calling thread.
+  static void flush();
+
+private:
+  // Called by the owner, or by anyone once the owner has exited. True when the merged count is zero.
+  static bool Merge(Counter& count) {
+    size_t bias = count.biased.load(std::memory_order_relaxed);
+    count.biased.store(0, std::memory_order_relaxed);
+    count.merged = true;
+    intptr_t old = count.shared.fetch_add(static_cast<intptr_t>(bias) * kUnit + kMerged, std::memory_order_acq_rel);
+    return (old >> kShift) + static_cast<intptr_t>(bias) == 0;
+  }
+
+  // Queued blocks carry a weak reference, so their memory outlives a merge that destroys the object.
+  template <typename Block>
+  static void MergeQueued(void* tmp) {
+    Block* block = static_cast<Block*>(tmp);
+    if (!block->shared_count.merged && Merge(block->shared_count)) {
+      block->SharedReachedZero();
+    }
+    block->Weak_TryToDeleteThisOne();
+  }
+};
+
+template <typename Block>
+bool BiasedCountPolicy::Decrement(Counter& count, Block* block) {
+  Owner* owner = Current();
+  if (count.owner == owner && !count.merged) {
+    size_t bias = count.biased.load(std::memory_order_relaxed) - 1;
+    count.biased.store(bias, std::memory_order_relaxed);
+    if (owner->pending.load(std::memory_order_relaxed)) {
+      flush();
+    }
+    return bias == 0 && Merge(count);
+  }
+
+  bool holdsWeak = false;
+  intptr_t old = count.shared.load(std::memory_order_relaxed);
+  while ((old & kMerged) == 0) {
+    intptr_t now = old - kUnit;
+    bool queue = (now >> kShift) < 0 && (old & kQueued) == 0;
+    if (queue) {
+      now |= kQueued;
+      if (!holdsWeak) {
+        block->IncreaseWeak();
+        holdsWeak = true;
+      }
+    }
+    if (!count.shared.compare_exchange_weak(old, now, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      continue;
+    }
+    if (!queue) {
+      if (holdsWeak) {
+        block->Weak_TryToDeleteThisOne();
+      }
+      return false;
+    }
+    Owner* target = count.owner;
+    std::unique_lock<std::mutex> lock(target->mutex);
+    if (!target->exited) {
+      target->queue.push_back(Pending{block, &MergeQueued<Block>});
+      target->pending.store(true, std::memory_order_relaxed);
+      return false;
+    }
+    lock.unlock();
+    bool zero = Merge(count);
+    block->Weak_TryToDeleteThisOne();
+    return zero;
+  }
+
+  // Merged: the weak reference can go first, since the caller's own share still keeps the object alive.
+  if (holdsWeak) {
+    block->Weak_TryToDeleteThisOne();
+  }
+  // The queued bit may still be set from before the merge, so only the count part is compared.
+  if (((count.shared.fetch_sub(kUnit, std::memory_order_release) - kUnit) >> kShift) == 0) {
+    count.shared.load(std::memory_order_acquire);
+    return true;
+  }
+  return false;
+}
+
+// Zero is only ever declared by a merge, so an unmerged block is alive whatever its two halves sum
+// to, and an increment that lands before the merge is counted by it.
+inline bool BiasedCountPolicy::IncrementIfNonZero(Counter& count) {
+  if (count.owner == Current() && !count.merged) {
+    count.biased.store(count.biased.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+  }
+  intptr_t old = count.shared.load(std::memory_order_relaxed);
+  do {
+    if ((old & kMerged) != 0 && (old >> kShift) == 0) {
+      return false;
+    }
+  } while (!count.shared.compare_exchange_weak(old, old + kUnit, std::memory_order_acq_rel, std::memory_order_relaxed));
+  return true;
+}
+
+inline void BiasedCountPolicy::flush() {
+  Owner* owner = Current();
+  if (owner == nullptr) {
+    return;
+  }
+  std::vector<Pending> queue;
+  {
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    queue.swap(owner->queue);
+    owner->pending.store(false, std::memory_order_relaxed);
+  }
+  for (const Pending& pending : queue) {
+    pending.merge(pending.block);
+  }
+}
+
+inline void BiasedCountPolicy::Exit() {
+  Owner* owner = Current();
+  std::vector<Pending> queue;
+  {
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    owner->exited = true;
+    queue.swap(owner->queue);
+  }
+  for (const Pending& pending : queue) {
+    pending.merge(pending.block);
+  }
+  Current() = nullptr;
+  Exited() = true;
+  ReleaseOwner(owner);
+}
+
+#if defined(SHARED_PTR_SINGLE_THREADED)
+using SharedPtrCountPolicy = NonAtomicCountPolicy;
+#elif defined(SHARED_PTR_BIASED_COUNT)
+using SharedPtrCountPolicy = BiasedCountPolicy;
+#else
+using SharedPtrCountPolicy = AtomicCountPolicy;
+#endif
+
+struct BaseControlBlock;
+
+// Opt-in deferred destruction. While a Scope is alive on a thread, objects whose last SharedPtr is
+// dropped there are queued instead of destroyed on the spot. drain(budget) destroys up to budget of
+// them, and releases those destructors cause are queued too, so a huge graph is torn down in bounded
+// slices. In Background mode the queue is handed in batches to a reclaimer thread instead.
+// Whatever is still queued when a thread exits is destroyed there.
+class DeferredReclaimer {
+public:
+  enum class Mode { Manual, Background };
+
+  class Scope {
+  private:
+    Mode previousMode_;
+
+  public:
+    explicit Scope(Mode mode = Mode::Manual);
+
+    Scope(const Scope& tmp) = delete;
+    Scope& operator=(const Scope& tmp) = delete;
+
+    ~Scope();
+  };
+
+  static bool active() { return Depth() > 0; }
+  static size_t pending() { return LocalQueue().blocks.size(); }
+  static size_t drain(size_t budget = static_cast<size_t>(-1));
+
+private:
+  friend struct BaseControlBlock;
+
+  static constexpr size_t kHandOffBatch = 256;
+
+  struct Queue {
+    std::deque<BaseControlBlock*> blocks;
+    ~Queue();
+  };
+
+  struct Background {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<BaseControlBlock*> blocks;
+    bool stop = false;
+    std::thread worker;
+
+    Background();
+    void Run();
+    ~Background();
+  };
+
+  // Trivially destructible, so a release during thread teardown after the queue is gone stays safe.
+  static int& Depth() {
+    thread_local int depth = 0;
+    return depth;
+  }
+
+  static Mode& CurrentMode() {
+    thread_local Mode mode = Mode::Manual;
+    return mode;
+  }
+
+  static Queue& LocalQueue() {
+    thread_local Queue queue;
+    return queue;
+  }
+
+  static Background& GetBackground() {
+    static Background background;
+    return background;
+  }
+
+  static void Defer(BaseControlBlock* cb);
+  static void HandOff(Queue& queue);
+};
+
+// weak_count holds one extra reference on behalf of all shared owners, dropped after the object
+// is destroyed, so exactly one thread sees it reach zero and frees the block.
+// Counters are updated inline; only the two zero-crossing paths go through the type-erased hook.
 struct BaseControlBlock {
-  size_t shared_count;
-  size_t weak_count;
+  using Policy = SharedPtrCountPolicy;
+  using WeakPolicy = typename Policy::WeakPolicy;
+
+  // Kind only asks which block type this is; the hook answers with KindOf<Block> or null.
+  enum class Operation { UseDeleter, Clean, Kind };
+  using Hook = const void* (*)(BaseControlBlock*, Operation);
+
+  // One writable byte per block type. Unlike the addresses of identical Dispatch instances, which
+  // identical-code folding may merge, these always differ.
+  template <typename Block>
+  static inline char kindTag = 0;
+
+  template <typename Block>
+  static const void* KindOf() { return &kindTag<Block>; }
+
+  typename Policy::Counter shared_count;
+  typename WeakPolicy::Counter weak_count;
+  Hook hook;
+#ifdef SHARED_PTR_TRACK_BLOCKS
+  ControlBlockRegistry::Node* tracked = nullptr;
+#endif
+
+  BaseControlBlock(size_t x, size_t y, Hook hook): shared_count(x), weak_count(y), hook(hook) {}
+
+  // Called once the block is fully built; T is the type reported by ControlBlockRegistry.
+  template <typename T>
+  void Track() {
+#ifdef SHARED_PTR_TRACK_BLOCKS
+    tracked = ControlBlockRegistry::Track<T>(this);
+#endif
+  }
+
+  // Safe to call more than once; blocks that can die without reaching Clean call it themselves.
+  void Untrack() {
+#ifdef SHARED_PTR_TRACK_BLOCKS
+    ControlBlockRegistry::Untrack(tracked);
+    tracked = nullptr;
+#endif
+  }
 
-  virtual void IncreaseShared() = 0;
-  virtual void IncreaseWeak() = 0;
+  size_t GiveWeak() const { return WeakPolicy::Load(weak_count) - (GiveShared() != 0 ? 1 : 0); }
+  size_t GiveShared() const { return Policy::Load(shared_count); }
+
+  void IncreaseShared() { Policy::Increment(shared_count); }
+  bool TryIncreaseShared() { return Policy::IncrementIfNonZero(shared_count); }
+  void IncreaseWeak() { WeakPolicy::Increment(weak_count); }
+
+  void Weak_TryToDeleteThisOne() {
+    if (WeakPolicy::Decrement(weak_count)) {
+      Untrack();
+      hook(this, Operation::Clean);
+    }
+  }
+
+  void Shared_TryToDeleteThisOne() {
+    if (DecrementShared()) {
+      SharedReachedZero();
+    }
+  }
+
+  // Policies that may need to queue the block (BiasedCountPolicy) take it as a second argument.
+  template <typename P = Policy>
+  bool DecrementShared() {
+    if constexpr (requires(typename P::Counter& count, BaseControlBlock* block) { P::Decrement(count, block); }) {
+      return P::Decrement(shared_count, this);
+    } else {
+      return P::Decrement(shared_count);
+    }
+  }
 
-  size_t& GiveWeak() { return weak_count; }
-  size_t& GiveShared() { return shared_count; }
+  void SharedReachedZero() {
+    if (DeferredReclaimer::active()) {
+      DeferredReclaimer::Defer(this);
+      return;
+    }
+    DestroyObject();
+  }
 
-  BaseControlBlock(size_t x, size_t y): shared_count(x), weak_count(y) {}
-  virtual void Weak_TryToDeleteThisOne() = 0;
-  virtual void Shared_TryToDeleteThisOne() = 0;
+  void DestroyObject() {
+    hook(this, Operation::UseDeleter);
+    Weak_TryToDeleteThisOne();
+  }
 
-  virtual void UseDeleter() = 0;
-  virtual ~BaseControlBlock() = default;
+  // Dispatches to Block::UseDeleter / Block::Clean without a vtable.
+  template <typename Block>
+  static const void* Dispatch(BaseControlBlock* base, Operation op) {
+    Block* block = static_cast<Block*>(base);
+    if (op == Operation::UseDeleter) {
+      block->UseDeleter();
+    } else if (op == Operation::Clean) {
+      block->Clean();
+    } else {
+      return KindOf<Block>();
+    }
+    return nullptr;
+  }
 };
 
+// A single-threaded build cannot hand blocks to another thread, so Background degrades to Manual.
+inline DeferredReclaimer::Scope::Scope(Mode mode): previousMode_(CurrentMode()) {
+#ifdef SHARED_PTR_SINGLE_THREADED
+  mode = Mode::Manual;
+#endif
+  CurrentMode() = mode;
+  ++Depth();
+}
+
+inline DeferredReclaimer::Scope::~Scope() {
+  if (CurrentMode() == Mode::Background) {
+    HandOff(LocalQueue());
+  }
+  CurrentMode() = previousMode_;
+  --Depth();
+}
+
+inline size_t DeferredReclaimer::drain(size_t budget) {
+  Queue& queue = LocalQueue();
+  Mode previous = CurrentMode();
+  CurrentMode() = Mode::Manual;
+  ++Depth();
+  size_t count = 0;
+  while (count < budget && !queue.blocks.empty()) {
+    BaseControlBlock* cb = queue.blocks.front();
+    queue.blocks.pop_front();
+    cb->DestroyObject();
+    ++count;
+  }
+  --Depth();
+  CurrentMode() = previous;
+  return count;
+}
+
+inline void DeferredReclaimer::Defer(BaseControlBlock* cb) {
+  Queue& queue = LocalQueue();
+  try {
+    queue.blocks.push_back(cb);
+  } catch (...) {
+    cb->DestroyObject();
+    return;
+  }
+  if (CurrentMode() == Mode::Background && queue.blocks.size() >= kHandOffBatch) {
+    HandOff(queue);
+  }
+}
+
+inline void DeferredReclaimer::HandOff(Queue& queue) {
+  if (queue.blocks.empty()) {
+    return;
+  }
+  Background& background = GetBackground();
+  {
+    std::lock_guard<std::mutex> lock(background.mutex);
+    background.blocks.insert(background.blocks.end(), queue.blocks.begin(), queue.blocks.end());
+  }
+  queue.blocks.clear();
+  background.ready.notify_one();
+}
+
+inline DeferredReclaimer::Queue::~Queue() {
+  Depth() = 0;
+  while (!blocks.empty()) {
+    BaseControlBlock* cb = blocks.front();
+    blocks.pop_front();
+    cb->DestroyObject();
+  }
+}
+
+inline DeferredReclaimer::Background::Background() : worker([this] { Run(); }) {}
+
+inline void DeferredReclaimer::Background::Run() {
+  std::vector<BaseControlBlock*> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return stop || !blocks.empty(); });
+      if (blocks.empty()) {
+        return;
+      }
+      batch.swap(blocks);
+    }
+    Queue& queue = LocalQueue();
+    queue.blocks.insert(queue.blocks.end(), batch.begin(), batch.end());
+    batch.clear();
+    drain();
+  }
+}
+
+inline DeferredReclaimer::Background::~Background() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  ready.notify_one();
+  worker.join();
+}
+
 template <typename T>
 class SharedPtr {
+public:
+  using element_type = std::remove_extent_t<T>;
+
 private:
+  template <typename U>
+  using DefaultDelete = std::conditional_t<std::is_array_v<T>, std::default_delete<U[]>, std::default_delete<U>>;
 
   BaseControlBlock* cb;
-  T* ptr;
+  element_type* ptr;
 
 public:
   template <typename U, typename... Args>
   friend SharedPtr<U> makeShared(Args&&... args);
 
   template <typename U, typename Alloc, typename... Args>
-  friend SharedPtr<U> allocateShared(const Alloc& alloc, Args&&... args);
+  friend SharedPtr<U> allocateShared(Alloc alloc, Args&&... args);
 
   template <typename U>
   friend class SharedPtr;
@@ -53,12 +640,23 @@ public:
 
   template <typename U>
   friend class EnableSharedFromThis;
+
+  template <typename U>
+  friend class AtomicSharedPtr;
+
+  template <typename U>
+  friend class IntrusivePtr;
+
+  template <typename U>
+  friend class CompactSharedPtr;
+
+  friend class EpochDomain;
  
   SharedPtr(): cb(nullptr), ptr(nullptr) {}
   SharedPtr(const SharedPtr<T>& sh_ptr);
 
   template <typename Deleter>
-  SharedPtr(T* tmp, Deleter deleter);
+  SharedPtr(element_type* tmp, Deleter deleter);
 
   SharedPtr& operator=(const SharedPtr<T>& sh_ptr);
 
@@ -74,7 +672,14 @@ public:
   template <class U, std::enable_if_t<check<T, U>::value, int> = 0>
   SharedPtr(WeakPtr<U>&& sh_ptr);
 
-  template <class U, class Deleter = std::default_delete<U>, class Alloc = std::allocator<U>, std::enable_if_t<check<T, U>::value, int> = 0>
+  // Aliasing: shares sh_ptr's ownership but points at tmp, typically a member of *sh_ptr.
+  template <class U>
+  SharedPtr(const SharedPtr<U>& sh_ptr, element_type* tmp) noexcept;
+
+  template <class U>
+  SharedPtr(SharedPtr<U>&& sh_ptr, element_type* tmp) noexcept;
+
+  template <class U, class Deleter = DefaultDelete<U>, class Alloc = std::allocator<U>, std::enable_if_t<check_pointer<T, U>::value, int> = 0>
   SharedPtr(U* tmp, Deleter deleter = Deleter(), Alloc alloc = Alloc());
 
   template <class U, std::enable_if_t<check<T, U>::value, int> = 0>
@@ -97,12 +702,29 @@ public:
   template <typename Y, typename Deleter, typename Alloc>
   void reset(Y* tmp, Deleter deleter, Alloc alloc);
 
-  T* get() const noexcept { return ptr; }
-  T& operator*() const noexcept { return *ptr; }
-  T* operator->() const noexcept { return ptr; }
+  element_type* get() const noexcept { return ptr; }
+  element_type& operator*() const noexcept { return *ptr; }
+  element_type* operator->() const noexcept { return ptr; }
+  element_type& operator[](std::ptrdiff_t index) const noexcept { return ptr[index]; }
 
   void swap(SharedPtr& tmp) noexcept;
-  size_t use_count() const { return cb->shared_count; }
+  size_t use_count() const { return cb == nullptr ? 0 : cb->GiveShared(); }
+
+// Owner-based comparison: two pointers are equivalent when they share a control block, whatever
+// they point at and whether or not the object is still alive.
+  template <typename U>
+  bool owner_before(const SharedPtr<U>& other) const noexcept { return std::less<const BaseControlBlock*>()(cb, other.cb); }
+
+  template <typename U>
+  bool owner_before(const WeakPtr<U>& other) const noexcept { return std::less<const BaseControlBlock*>()(cb, other.cb); }
+
+  template <typename U>
+  bool owner_equal(const SharedPtr<U>& other) const noexcept { return cb == other.cb; }
+
+  template <typename U>
+  bool owner_equal(const WeakPtr<U>& other) const noexcept { return cb == other.cb; }
+
+  size_t owner_hash() const noexcept { return std::hash<const BaseControlBlock*>()(cb); }
 
   template <typename U, typename Deleter = std::default_delete<U>,
   typename Alloc = std::allocator<U>>
@@ -112,9 +734,9 @@ public:
     Alloc alloc;
 
     ControlBlockRegular(U* ptr, Deleter deleter, Alloc alloc):
-      BaseControlBlock(1, 0), object(ptr), deleter(deleter), alloc(alloc) {}
+      BaseControlBlock(1, 1, &Dispatch<ControlBlockRegular>), object(ptr), deleter(deleter), alloc(alloc) {}
 
-    virtual void UseDeleter() {
+    void UseDeleter() {
       deleter(object);
     }
 
@@ -122,29 +744,10 @@ public:
       using AllocBlock = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockRegular<U, Deleter, Alloc>>;
       using AllocBlockTraits = std::allocator_traits<AllocBlock>;
       AllocBlock newAlloc = alloc;
+      this->~ControlBlockRegular();
       AllocBlockTraits::deallocate(newAlloc, this, 1);  
     }
 
-    virtual void Weak_TryToDeleteThisOne() {
-      --BaseControlBlock::weak_count;
-      if (BaseControlBlock::weak_count == 0 && BaseControlBlock::shared_count == 0) {
-        Clean();
-      }
-    }
-
-    virtual void Shared_TryToDeleteThisOne() {
-      --BaseControlBlock::shared_count;
-      if (BaseControlBlock::shared_count == 0) {
-        UseDeleter();
-        if (BaseControlBlock::weak_count == 0) {
-          Clean();
-        }
-      }
-    }
-
-    virtual void IncreaseShared() { ++BaseControlBlock::shared_count; }
-    virtual void IncreaseWeak() { ++BaseControlBlock::weak_count; }
-
     ~ControlBlockRegular() {}
   };
 
@@ -155,7 +758,7 @@ public:
 
     template <class... Args>
     ControlBlockMakeShared(const Alloc& alloc, Args&&... args): 
-          BaseControlBlock(0, 0), alloc(alloc) {
+          BaseControlBlock(0, 1, &Dispatch<ControlBlockMakeShared>), alloc(alloc) {
       new(reinterpret_cast<U*>(object)) U(std::forward<Args>(args)...);      
     }
 
@@ -163,62 +766,132 @@ public:
       using AllocBlock = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockMakeShared<U, Alloc>>;
       using AllocBlockTraits = std::allocator_traits<AllocBlock>;
       AllocBlock newAlloc = alloc;
+      this->~ControlBlockMakeShared();
       AllocBlockTraits::deallocate(newAlloc, this, 1);
     }
 
-    virtual void UseDeleter() {
+    void UseDeleter() {
       std::allocator_traits<Alloc>::destroy(alloc, reinterpret_cast<U*>(object));
     }
 
-    virtual void Weak_TryToDeleteThisOne() {
-      --BaseControlBlock::weak_count;
-      if (BaseControlBlock::weak_count == 0 && BaseControlBlock::shared_count == 0) {
-        Clean();
-      }
+    ~ControlBlockMakeShared() {}
+  };
+
+  // The elements are placed right after the block, in the same allocation.
+  template <typename Alloc>
+  struct ControlBlockArray: public BaseControlBlock {
+    struct alignas(std::max(alignof(BaseControlBlock), alignof(element_type))) Unit {
+      char bytes[std::max(alignof(BaseControlBlock), alignof(element_type))];
+    };
+
+    using ElementAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<element_type>;
+    using UnitAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Unit>;
+
+    size_t count;
+    size_t units;
+    ElementAlloc alloc;
+
+    static constexpr size_t kOffset = (sizeof(ControlBlockArray) + alignof(element_type) - 1) / alignof(element_type) * alignof(element_type);
+
+    static size_t UnitsFor(size_t count) {
+      return (kOffset + count * sizeof(element_type) + sizeof(Unit) - 1) / sizeof(Unit);
     }
 
-   virtual void Shared_TryToDeleteThisOne() {
-      --BaseControlBlock::shared_count;
-      if (BaseControlBlock::shared_count == 0) {
-        UseDeleter();
-        if (BaseControlBlock::weak_count == 0) {
-          Clean();
-        }
+    ControlBlockArray(const Alloc& alloc, size_t count, size_t units):
+          BaseControlBlock(0, 1, &Dispatch<ControlBlockArray>), count(count), units(units), alloc(alloc) {}
+
+    element_type* Elements() {
+      return reinterpret_cast<element_type*>(reinterpret_cast<char*>(this) + kOffset);
+    }
+
+    void DestroyElements(size_t constructed) {
+      element_type* elements = Elements();
+      while (constructed > 0) {
+        std::allocator_traits<ElementAlloc>::destroy(alloc, elements + --constructed);
       }
     }
 
-    virtual void IncreaseShared() { ++BaseControlBlock::shared_count; }
-    virtual void IncreaseWeak() { ++BaseControlBlock::weak_count; }
+    void UseDeleter() {
+      DestroyElements(count);
+    }
 
-    ~ControlBlockMakeShared() {}
+    void Clean() {
+      UnitAlloc unitAlloc = alloc;
+      size_t size = units;
+      this->~ControlBlockArray();
+      std::allocator_traits<UnitAlloc>::deallocate(unitAlloc, reinterpret_cast<Unit*>(this), size);
+    }
+
+    ~ControlBlockArray() {}
   };
 
-  bool ProveDestroyed() { return ptr == nullptr && cb == nullptr; }
-  SharedPtr(BaseControlBlock* cb, T* ptr): cb(cb), ptr(ptr) { cb->IncreaseShared(); }
+  bool ProveDestroyed() { return cb == nullptr; }
+  SharedPtr(BaseControlBlock* cb, element_type* ptr): cb(cb), ptr(ptr) { cb->IncreaseShared(); }
+
+  // Empty if the object behind cb is already gone or being destroyed.
+  static SharedPtr Lock(BaseControlBlock* cb, element_type* ptr) noexcept;
 
-  template<class U, typename Deleter, typename Alloc, std::enable_if_t<check<T, U>::value, int> = 0>
+  template<class U, typename Deleter, typename Alloc, std::enable_if_t<check_pointer<T, U>::value, int> = 0>
   void CreationRegular(U* tmp, Deleter deleter, Alloc alloc);
+
+  template <typename Alloc, typename... Value>
+  static SharedPtr CreationArray(const Alloc& alloc, size_t count, const Value&... value);
 };
 
-template <typename T, typename Alloc, typename... Args>
-SharedPtr<T> allocateShared(Alloc alloc, Args&&... args) {
-  using AllocBlock = typename std::allocator_traits<Alloc>::template rebind_alloc<typename SharedPtr<T>::template ControlBlockMakeShared<T, Alloc>>;
-  using AllocBlockTraits = std::allocator_traits<AllocBlock>;
-  AllocBlock newAlloc = alloc;
-  typename SharedPtr<T>::template ControlBlockMakeShared<T, Alloc>* new_cb = AllocBlockTraits::allocate(newAlloc, 1);
+template <typename T>
+template <typename Alloc, typename... Value>
+SharedPtr<T> SharedPtr<T>::CreationArray(const Alloc& alloc, size_t count, const Value&... value) {
+  using Block = ControlBlockArray<Alloc>;
+  using UnitAlloc = typename Block::UnitAlloc;
+  using ElementAlloc = typename Block::ElementAlloc;
+  UnitAlloc unitAlloc = alloc;
+  size_t units = Block::UnitsFor(count);
+  Block* new_cb = reinterpret_cast<Block*>(std::allocator_traits<UnitAlloc>::allocate(unitAlloc, units));
+  new(new_cb) Block(alloc, count, units);
+  element_type* elements = new_cb->Elements();
+  size_t constructed = 0;
   try {
-    AllocBlockTraits::construct(newAlloc, new_cb, alloc, std::forward<Args>(args)...);
+    for (; constructed < count; ++constructed) {
+      std::allocator_traits<ElementAlloc>::construct(new_cb->alloc, elements + constructed, value...);
+    }
   } catch (...) {
-    AllocBlockTraits::deallocate(newAlloc, new_cb, 1);
+    new_cb->DestroyElements(constructed);
+    new_cb->Clean();
+    throw;
+  }
+  new_cb->template Track<T>();
+  return SharedPtr<T>(new_cb, elements);
+}
+
+// allocateShared<T[]>(alloc, n[, value]) and allocateShared<T[N]>(alloc[, value]) build the array
+// in the same allocation as the control block.
+template <typename T, typename Alloc, typename... Args>
+SharedPtr<T> allocateShared(Alloc alloc, Args&&... args) {
+  if constexpr (std::is_unbounded_array_v<T>) {
+    return SharedPtr<T>::CreationArray(alloc, args...);
+  } else if constexpr (std::is_bounded_array_v<T>) {
+    return SharedPtr<T>::CreationArray(alloc, std::extent_v<T>, args...);
+  } else {
+    using AllocBlock = typename std::allocator_traits<Alloc>::template rebind_alloc<typename SharedPtr<T>::template ControlBlockMakeShared<T, Alloc>>;
+    using AllocBlockTraits = std::allocator_traits<AllocBlock>;
+    AllocBlock newAlloc = alloc;
+    typename SharedPtr<T>::template ControlBlockMakeShared<T, Alloc>* new_cb = AllocBlockTraits::allocate(newAlloc, 1);
+    try {
+      AllocBlockTraits::construct(newAlloc, new_cb, alloc, std::forward<Args>(args)...);
+    } catch (...) {
+      AllocBlockTraits::deallocate(newAlloc, new_cb, 1);
+      throw;
+    }
+    new_cb->template Track<T>();
+    auto ptr = (reinterpret_cast<T*>(new_cb->object));
+    return SharedPtr<T>(new_cb, ptr);
   }
-  auto cb = new_cb;
-  auto ptr = (reinterpret_cast<T*>(new_cb->object));
-  return SharedPtr<T>(new_cb, ptr);
 }
 
 template <typename T, typename... Args>
 SharedPtr<T> makeShared(Args&&... args) {
-  return allocateShared<T, std::allocator<T>, Args...>(std::allocator<T>(), std::forward<Args>(args)...);
+  using Alloc = std::allocator<std::remove_extent_t<T>>;
+  return allocateShared<T, Alloc, Args...>(Alloc(), std::forward<Args>(args)...);
 }
 
 template<typename T>
@@ -226,15 +899,26 @@ class WeakPtr {
   template <typename U>
   friend class WeakPtr;
 
+  using element_type = std::remove_extent_t<T>;
+
   BaseControlBlock* cb;
-  T* ptr;
+  element_type* ptr;
 
-  bool ProveDestroyed() { return ptr == nullptr && cb == nullptr; }
+  template <typename U>
+  friend class SharedPtr;
+
+  bool ProveDestroyed() { return cb == nullptr; }
+
+  void AddWeak() {
+    if (cb != nullptr) {
+      cb->IncreaseWeak();
+    }
+  }
 public:
 
   constexpr WeakPtr() noexcept: cb(nullptr), ptr(nullptr) {}
-  WeakPtr(const WeakPtr& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) { cb->IncreaseWeak(); }
-  WeakPtr(const SharedPtr<T>& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) { cb->IncreaseWeak(); }
+  WeakPtr(const WeakPtr& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) { AddWeak(); }
+  WeakPtr(const SharedPtr<T>& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) { AddWeak(); }
 
   WeakPtr(WeakPtr&& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) {
     tmp.cb = nullptr;
@@ -242,10 +926,10 @@ public:
   }
   
   template <typename U, std::enable_if_t<check<T, U>::value, int> = 0>
-  WeakPtr(const WeakPtr<U>& tmp) noexcept: cb(tmp.cb), ptr(static_cast<T*>(tmp.ptr)) { cb->IncreaseWeak(); } 
+  WeakPtr(const WeakPtr<U>& tmp) noexcept: cb(tmp.cb), ptr(static_cast<element_type*>(tmp.ptr)) { AddWeak(); }
   
   template <typename U, std::enable_if_t<check<T, U>::value, int> = 0>
-  WeakPtr(const SharedPtr<U>& tmp) noexcept: cb(tmp.cb), ptr(static_cast<T*>(tmp.ptr)) { cb->IncreaseWeak(); }
+  WeakPtr(const SharedPtr<U>& tmp) noexcept: cb(tmp.cb), ptr(static_cast<element_type*>(tmp.ptr)) { AddWeak(); }
 
   template <typename U, std::enable_if_t<check<T, U>::value, int> = 0>
   WeakPtr(WeakPtr<U>&& tmp) noexcept: cb(tmp.cb), ptr(tmp.ptr) {
@@ -253,11 +937,25 @@ public:
     tmp.ptr = nullptr;
   }
   
-  bool expired() const noexcept { return cb->GiveShared() == 0; }
+  bool expired() const noexcept { return cb == nullptr || cb->GiveShared() == 0; }
   
-  size_t use_count() { return cb->GiveShared(); }
+  size_t use_count() const { return cb == nullptr ? 0 : cb->GiveShared(); }
+
+  SharedPtr<T> lock() const noexcept { return SharedPtr<T>::Lock(cb, ptr); }
+
+  template <typename U>
+  bool owner_before(const SharedPtr<U>& other) const noexcept { return std::less<const BaseControlBlock*>()(cb, other.cb); }
+
+  template <typename U>
+  bool owner_before(const WeakPtr<U>& other) const noexcept { return std::less<const BaseControlBlock*>()(cb, other.cb); }
+
+  template <typename U>
+  bool owner_equal(const SharedPtr<U>& other) const noexcept { return cb == other.cb; }
+
+  template <typename U>
+  bool owner_equal(const WeakPtr<U>& other) const noexcept { return cb == other.cb; }
 
-  SharedPtr<T> lock() const { return SharedPtr<T>(cb, ptr); }
+  size_t owner_hash() const noexcept { return std::hash<const BaseControlBlock*>()(cb); }
 
   template <class U, std::enable_if_t<check<T, U>::value, int> = 0>
   WeakPtr& operator=(WeakPtr<U>&& tmp) noexcept;
@@ -303,7 +1001,7 @@ typename WeakPtr<T>::WeakPtr& WeakPtr<T>::operator=(WeakPtr<U>&& tmp) noexcept {
     cb->Weak_TryToDeleteThisOne();
   }
   cb = tmp.cb;
-  ptr = static_cast<T*>(tmp.ptr);
+  ptr = static_cast<element_type*>(tmp.ptr);
   tmp.cb = nullptr;
   tmp.ptr = nullptr;
   return *this;
@@ -323,36 +1021,42 @@ typename WeakPtr<T>::WeakPtr& WeakPtr<T>::operator=(WeakPtr<T>&& tmp) noexcept {
 
 template <typename T>
 typename WeakPtr<T>::WeakPtr& WeakPtr<T>::operator=(const WeakPtr& tmp) noexcept {
+  if (tmp.cb != nullptr) {
+    tmp.cb->IncreaseWeak();
+  }
   if (!ProveDestroyed()) {
     cb->Weak_TryToDeleteThisOne();
   }
   cb = tmp.cb;
-  ptr = tmp.ptr;
-  cb->IncreaseWeak();
+  ptr = static_cast<element_type*>(tmp.ptr);
   return *this;
 }
 
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
 typename WeakPtr<T>::WeakPtr& WeakPtr<T>::operator=(const WeakPtr<U>& tmp) noexcept {
+  if (tmp.cb != nullptr) {
+    tmp.cb->IncreaseWeak();
+  }
   if (!ProveDestroyed()) {
     cb->Weak_TryToDeleteThisOne();
   }
   cb = tmp.cb;
-  ptr = static_cast<T*>(tmp.ptr);
-  cb->IncreaseWeak();
+  ptr = static_cast<element_type*>(tmp.ptr);
   return *this;
 }
 
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
 typename  WeakPtr<T>::WeakPtr& WeakPtr<T>::operator=(const SharedPtr<U>& tmp) noexcept {
+  if (tmp.cb != nullptr) {
+    tmp.cb->IncreaseWeak();
+  }
   if (!ProveDestroyed()) {
     cb->Weak_TryToDeleteThisOne();
   }
   cb = tmp.cb;
-  ptr = tmp.ptr;
-  cb->IncreaseWeak();
+  ptr = static_cast<element_type*>(tmp.ptr);
   return *this;
 }
 
@@ -371,9 +1075,9 @@ void SharedPtr<T>::reset(U* tmp) {
   if (!ProveDestroyed()) {
     cb->Shared_TryToDeleteThisOne();
   }
-  ptr = reinterpret_cast<T*>(tmp);
+  ptr = static_cast<element_type*>(tmp);
   std::allocator<U> alloc;
-  std::default_delete<U> deleter;
+  DefaultDelete<U> deleter;
   CreationRegular(tmp, deleter, alloc);
 }
 
@@ -383,7 +1087,7 @@ void SharedPtr<T>::reset(U* tmp, Deleter deleter) {
   if (!ProveDestroyed()) {
     cb->Shared_TryToDeleteThisOne();
   }
-  ptr = static_cast<T*>(tmp);
+  ptr = static_cast<element_type*>(tmp);
   std::allocator<U> alloc;
   CreationRegular(tmp, deleter, alloc);
 }
@@ -394,18 +1098,21 @@ void SharedPtr<T>::reset(Y* tmp, Deleter deleter, Alloc alloc) {
   if (!ProveDestroyed()) {
     cb->Shared_TryToDeleteThisOne();
   }
-  ptr = static_cast<T*>(tmp);
+  ptr = static_cast<element_type*>(tmp);
   CreationRegular(tmp, deleter, alloc);
 }
 
 template <typename T>
-template<class U, typename Deleter, typename Alloc, std::enable_if_t<check<T, U>::value, int>>
+template<class U, typename Deleter, typename Alloc, std::enable_if_t<check_pointer<T, U>::value, int>>
 void SharedPtr<T>::CreationRegular(U* tmp, Deleter deleter, Alloc alloc) {
-  using AllocBlock = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockRegular<U, Deleter, Alloc>>;
+  using BlockAlloc = typename ControlBlockAllocator<Alloc>::type;
+  using AllocBlock = typename std::allocator_traits<BlockAlloc>::template rebind_alloc<ControlBlockRegular<U, Deleter, BlockAlloc>>;
   using AllocBlockTraits = std::allocator_traits<AllocBlock>;
-  AllocBlock newAlloc = alloc;
-  ControlBlockRegular<U, Deleter, Alloc>* new_cb = AllocBlockTraits::allocate(newAlloc, 1);
-  new(new_cb) ControlBlockRegular<U, Deleter, Alloc>(tmp, deleter, alloc);
+  BlockAlloc blockAlloc = alloc;
+  AllocBlock newAlloc = blockAlloc;
+  ControlBlockRegular<U, Deleter, BlockAlloc>* new_cb = AllocBlockTraits::allocate(newAlloc, 1);
+  new(new_cb) ControlBlockRegular<U, Deleter, BlockAlloc>(tmp, deleter, blockAlloc);
+  new_cb->template Track<U>();
   cb = new_cb;
 }
 
@@ -418,41 +1125,72 @@ SharedPtr<T>::SharedPtr(const SharedPtr<T>& sh_ptr): cb(sh_ptr.cb), ptr(sh_ptr.p
 
 template <typename T>
 template <typename Deleter>
-SharedPtr<T>::SharedPtr(T* tmp, Deleter deleter): cb(nullptr), ptr(tmp) {
-  std::allocator<T> alloc;
+SharedPtr<T>::SharedPtr(element_type* tmp, Deleter deleter): cb(nullptr), ptr(tmp) {
+  std::allocator<element_type> alloc;
   CreationRegular(tmp, deleter, alloc);
 }
 
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
-SharedPtr<T>::SharedPtr(const SharedPtr<U>& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<T*>(sh_ptr.ptr)) {
-  cb->IncreaseShared();
+SharedPtr<T>::SharedPtr(const SharedPtr<U>& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<element_type*>(sh_ptr.ptr)) {
+  if (!ProveDestroyed()) {
+    cb->IncreaseShared();
+  }
 }
 
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
-SharedPtr<T>::SharedPtr(SharedPtr<U>&& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<T*>(sh_ptr.ptr)) {
+SharedPtr<T>::SharedPtr(SharedPtr<U>&& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<element_type*>(sh_ptr.ptr)) {
   sh_ptr.cb = nullptr;
   sh_ptr.ptr = nullptr;
 }
 
 template <typename T>
-template <class U, std::enable_if_t<check<T, U>::value, int>>
-SharedPtr<T>::SharedPtr(const WeakPtr<U>& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<T*>(sh_ptr.ptr)) {
-  cb->IncreaseShared();
+template <class U>
+SharedPtr<T>::SharedPtr(const SharedPtr<U>& sh_ptr, element_type* tmp) noexcept: cb(sh_ptr.cb), ptr(tmp) {
+  if (!ProveDestroyed()) {
+    cb->IncreaseShared();
+  }
 }
 
 template <typename T>
-template <class U, std::enable_if_t<check<T, U>::value, int>>
-SharedPtr<T>::SharedPtr(WeakPtr<U>&& sh_ptr): cb(sh_ptr.cb), ptr(static_cast<T*>(sh_ptr.ptr)) {
+template <class U>
+SharedPtr<T>::SharedPtr(SharedPtr<U>&& sh_ptr, element_type* tmp) noexcept: cb(sh_ptr.cb), ptr(tmp) {
   sh_ptr.cb = nullptr;
   sh_ptr.ptr = nullptr;
 }
 
+template <typename T>
+SharedPtr<T> SharedPtr<T>::Lock(BaseControlBlock* cb, element_type* ptr) noexcept {
+  SharedPtr result;
+  if (cb != nullptr && cb->TryIncreaseShared()) {
+    result.cb = cb;
+    result.ptr = ptr;
+  }
+  return result;
+}
+
+template <typename T>
+template <class U, std::enable_if_t<check<T, U>::value, int>>
+SharedPtr<T>::SharedPtr(const WeakPtr<U>& sh_ptr): cb(nullptr), ptr(nullptr) {
+  if (sh_ptr.cb == nullptr || !sh_ptr.cb->TryIncreaseShared()) {
+    throw std::bad_weak_ptr();
+  }
+  cb = sh_ptr.cb;
+  ptr = static_cast<element_type*>(sh_ptr.ptr);
+}
+
+// The weak reference is given back only once the strong one is taken, so sh_ptr is untouched on throw.
+template <typename T>
+template <class U, std::enable_if_t<check<T, U>::value, int>>
+SharedPtr<T>::SharedPtr(WeakPtr<U>&& sh_ptr): SharedPtr(static_cast<const WeakPtr<U>&>(sh_ptr)) {
+  WeakPtr<U> released = std::move(sh_ptr);
+}
+
 template <typename T>
 template <class U, class Deleter, class Alloc,
-          std::enable_if_t<check<T, U>::value, int>>
-SharedPtr<T>::SharedPtr(U* tmp, Deleter deleter, Alloc alloc): cb(nullptr), ptr(static_cast<T*>(tmp)) {
+          std::enable_if_t<check_pointer<T, U>::value, int>>
+SharedPtr<T>::SharedPtr(U* tmp, Deleter deleter, Alloc alloc): cb(nullptr), ptr(static_cast<element_type*>(tmp)) {
   CreationRegular(tmp, deleter, alloc);
 }
 
@@ -465,25 +1203,14 @@ void SharedPtr<T>::swap(SharedPtr& tmp) noexcept {
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
 typename SharedPtr<T>::SharedPtr& SharedPtr<T>::operator=(const SharedPtr<U>& sh_ptr) {
-    if (!ProveDestroyed()) {
-      cb->Shared_TryToDeleteThisOne();
-    }
-    cb = sh_ptr.cb;
-    ptr = static_cast<T*>(sh_ptr.ptr);
-    cb->IncreaseShared();
-    return *this;
-  }
+  SharedPtr<T>(sh_ptr).swap(*this);
+  return *this;
+}
 
 template <typename T>
 template <class U, std::enable_if_t<check<T, U>::value, int>>
 typename SharedPtr<T>::SharedPtr& SharedPtr<T>::operator=(SharedPtr<U>&& sh_ptr) {
-  if (!ProveDestroyed()) {
-    cb->Shared_TryToDeleteThisOne();
-  }
-  cb = sh_ptr.cb;
-  ptr = static_cast<T*>(sh_ptr.ptr);
-  sh_ptr.cb = nullptr;
-  sh_ptr.ptr = nullptr;
+  SharedPtr<T>(std::move(sh_ptr)).swap(*this);
   return *this;
 }
 
@@ -498,11 +1225,28 @@ SharedPtr<T>::~SharedPtr() {
 
 template <typename T>
 typename SharedPtr<T>::SharedPtr& SharedPtr<T>::operator=(const SharedPtr<T>& sh_ptr) {
-  if (!ProveDestroyed()) {
-    cb->Shared_TryToDeleteThisOne();
-  }
-  cb = sh_ptr.cb;
-  ptr = sh_ptr.ptr;
-  cb->IncreaseShared();
+  SharedPtr<T>(sh_ptr).swap(*this);
   return *this;
 }
+
+// Owner-based functors, so SharedPtr and WeakPtr (mixed freely) can key ordered and hashed containers.
+struct OwnerLess {
+  using is_transparent = void;
+
+  template <typename Left, typename Right>
+  bool operator()(const Left& left, const Right& right) const noexcept { return left.owner_before(right); }
+};
+
+struct OwnerHash {
+  using is_transparent = void;
+
+  template <typename Ptr>
+  size_t operator()(const Ptr& tmp) const noexcept { return tmp.owner_hash(); }
+};
+
+struct OwnerEqual {
+  using is_transparent = void;
+
+  template <typename Left, typename Right>
+  bool operator()(const Left& left, const Right& right) const noexcept { return left.owner_equal(right); }
+};
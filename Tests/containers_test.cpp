@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "test.h"
+#include "../List/list.h"
+#include "../List/intrusive_list.h"
+#include "../LruCache/lru_cache.h"
+#include "../MpscQueue/mpsc_queue.h"
+
+namespace {
+
+template <typename T, typename Alloc>
+std::vector<T> Contents(const List<T, Alloc>& lst) {
+  return std::vector<T>(lst.begin(), lst.end());
+}
+
+List<int> Sequence(int first, int last) {
+  List<int> lst;
+  for (int i = first; i < last; ++i) {
+    lst.push_back(i);
+  }
+  return lst;
+}
+
+// Ordered by key only, so the tag shows whether equal keys kept their relative order.
+struct Keyed {
+  int key;
+  int tag;
+
+  bool operator<(const Keyed& other) const { return key < other.key; }
+  bool operator==(const Keyed& other) const { return key == other.key && tag == other.tag; }
+};
+
+struct Item: IntrusiveListHook<> {
+  int value;
+
+  explicit Item(int value) : value(value) {}
+};
+
+struct ByAge {};
+struct ByName {};
+
+// Sits in two lists at once, one per tag; leaving scope takes it out of both.
+struct Person: IntrusiveListHook<true, ByAge>, IntrusiveListHook<true, ByName> {
+  int id;
+
+  explicit Person(int id) : id(id) {}
+};
+
+template <typename T, typename Tag>
+std::vector<int> Ids(const IntrusiveList<T, Tag>& lst) {
+  std::vector<int> ids;
+  for (const T& item : lst) {
+    ids.push_back(item.id);
+  }
+  return ids;
+}
+
+}  // namespace
+
+TEST(ListSpliceMovesNodes) {
+  List<int> left = Sequence(0, 5);
+  List<int> right = Sequence(10, 15);
+  const int* moved = &*std::next(right.begin());
+
+  left.splice(std::next(left.begin()), right, std::next(right.begin()));
+  CHECK(&*std::next(left.begin()) == moved);
+  CHECK((Contents(left) == std::vector<int>{0, 11, 1, 2, 3, 4}));
+  CHECK((Contents(right) == std::vector<int>{10, 12, 13, 14}));
+
+  left.splice(left.end(), right, right.begin(), std::prev(right.end()));
+  CHECK((Contents(left) == std::vector<int>{0, 11, 1, 2, 3, 4, 10, 12, 13}));
+  CHECK(right.size() == 1);
+
+  left.splice(left.begin(), right);
+  CHECK(right.empty() && left.size() == 10 && *left.begin() == 14);
+
+  left.splice(left.end(), left, left.begin(), std::next(left.begin(), 3));
+  CHECK((Contents(left) == std::vector<int>{1, 2, 3, 4, 10, 12, 13, 14, 0, 11}));
+  CHECK(left.size() == 10);
+}
+
+TEST(ListSpliceAfterCompactKeepsAddresses) {
+  List<int> left = Sequence(0, 100);
+  List<int> right = Sequence(100, 200);
+  left.compact();
+  right.compact();
+
+  std::vector<const int*> addresses;
+  for (const int& value : right) {
+    addresses.push_back(&value);
+  }
+  left.splice(left.end(), right, std::next(right.begin(), 50), right.end());
+  left.splice(left.begin(), right);
+  CHECK(right.empty() && left.size() == 200);
+
+  std::vector<const int*> seen;
+  for (const int& value : left) {
+    seen.push_back(&value);
+  }
+  for (size_t i = 0; i < 50; ++i) {
+    CHECK(seen[i] == addresses[i]);
+    CHECK(seen[150 + i] == addresses[50 + i]);
+  }
+  while (!left.empty()) {
+    left.erase(left.begin());
+  }
+}
+
+TEST(ListKeepsSlabNodesOfDestroyedList) {
+  List<int> kept = Sequence(0, 10);
+  {
+    List<int> source = Sequence(10, 30);
+    source.compact();
+    kept.splice(kept.end(), source, std::next(source.begin(), 5), std::next(source.begin(), 15));
+    kept.splice(kept.begin(), source, source.begin());
+  }
+  CHECK(kept.size() == 21 && *kept.begin() == 10);
+  kept.compact();
+  kept.splice(kept.end(), Sequence(30, 35));
+  kept.remove_if([](int value) { return value % 2 == 0; });
+  CHECK((Contents(kept) == std::vector<int>{1, 3, 5, 7, 9, 15, 17, 19, 21, 23, 31, 33}));
+}
+
+TEST(ListRemoveByReferenceToElement) {
+  List<std::string> lst;
+  for (const char* value : {"a", "b", "a", "c", "a"}) {
+    lst.push_back(value);
+  }
+  CHECK(lst.remove(*lst.begin()) == 3);
+  CHECK((Contents(lst) == std::vector<std::string>{"b", "c"}));
+  CHECK(lst.remove(*std::next(lst.begin())) == 1);
+  CHECK((Contents(lst) == std::vector<std::string>{"b"}));
+  CHECK(lst.remove_if([](const std::string& value) { return value == "b"; }) == 1 && lst.empty());
+}
+
+TEST(ListMergeIsStable) {
+  List<Keyed> left;
+  List<Keyed> right;
+  for (int i = 0; i < 10; ++i) {
+    left.push_back(Keyed{i * 2, 0});
+    right.push_back(Keyed{i, 1});
+  }
+  left.merge(right);
+  CHECK(right.empty() && left.size() == 20);
+
+  std::vector<Keyed> expected;
+  for (int i = 0; i < 10; ++i) {
+    expected.push_back(Keyed{i * 2, 0});
+    expected.push_back(Keyed{i, 1});
+  }
+  std::stable_sort(expected.begin(), expected.end());
+  CHECK(Contents(left) == expected);
+}
+
+TEST(ListSortMatchesStableSort) {
+  std::mt19937 rng(7);
+  for (size_t size : {0, 1, 2, 3, 17, 1000}) {
+    List<Keyed> lst;
+    std::vector<Keyed> expected;
+    for (size_t i = 0; i < size; ++i) {
+      Keyed value{static_cast<int>(rng() % 50), static_cast<int>(i)};
+      lst.push_back(value);
+      expected.push_back(value);
+    }
+    lst.sort();
+    std::stable_sort(expected.begin(), expected.end());
+    CHECK(Contents(lst) == expected);
+  }
+}
+
+TEST(ListSortKeepsElementsWhenCompareThrows) {
+  List<int> lst;
+  for (int i = 0; i < 200; ++i) {
+    lst.push_back((i * 37) % 200);
+  }
+  int calls = 0;
+  bool threw = false;
+  try {
+    lst.sort([&](int left, int right) {
+      if (++calls == 500) {
+        throw std::runtime_error("compare");
+      }
+      return left < right;
+    });
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw);
+  std::vector<int> values = Contents(lst);
+  std::sort(values.begin(), values.end());
+  CHECK(lst.size() == 200 && values.size() == 200);
+  for (int i = 0; i < 200; ++i) {
+    CHECK(values[i] == i);
+  }
+}
+
+TEST(ListCompactPreservesOrder) {
+  List<std::string> lst;
+  for (int i = 0; i < 300; ++i) {
+    lst.push_back(std::to_string(i));
+  }
+  for (auto it = lst.begin(); it != lst.end();) {
+    auto next = std::next(it);
+    if (std::stoi(*it) % 3 == 0) {
+      lst.erase(it);
+    }
+    it = next;
+  }
+  std::vector<std::string> before = Contents(lst);
+
+  CHECK(!lst.compact(10));
+  lst.erase(lst.begin());
+  before.erase(before.begin());
+  while (!lst.compact(10)) {}
+  CHECK(Contents(lst) == before);
+
+  lst.compact();
+  CHECK(Contents(lst) == before);
+  lst.clear();
+  CHECK(lst.empty());
+}
+
+TEST(ListAssignReusesNodes) {
+  List<std::string> lst;
+  for (int i = 0; i < 5; ++i) {
+    lst.push_back(std::to_string(i));
+  }
+  const std::string* first = &*lst.begin();
+  std::vector<std::string> shorter{"a", "b", "c"};
+  lst.assign(shorter.begin(), shorter.end());
+  CHECK(Contents(lst) == shorter && &*lst.begin() == first);
+
+  std::vector<std::string> longer{"v", "w", "x", "y", "z", "zz"};
+  lst.assign(longer.begin(), longer.end());
+  CHECK(Contents(lst) == longer && lst.size() == 6);
+
+  lst.assign(2, "k");
+  CHECK((Contents(lst) == std::vector<std::string>{"k", "k"}));
+  lst.assign(shorter.end(), shorter.end());
+  CHECK(lst.empty());
+}
+
+TEST(ListMoveAssignment) {
+  List<int> source = Sequence(0, 10);
+  const int* first = &*source.begin();
+  List<int> target = Sequence(100, 103);
+  target = std::move(source);
+  CHECK(source.empty() && source.begin() == source.end());
+  CHECK(Contents(target) == Contents(Sequence(0, 10)) && &*target.begin() == first);
+  source.push_back(5);
+  CHECK(source.size() == 1 && target.size() == 10);
+
+  StackStorage<4096> left_storage;
+  StackStorage<4096> right_storage;
+  List<int, StackAllocator<int, 4096>> left{StackAllocator<int, 4096>(left_storage)};
+  List<int, StackAllocator<int, 4096>> right{StackAllocator<int, 4096>(right_storage)};
+  for (int i = 0; i < 5; ++i) {
+    left.push_back(i);
+    right.push_back(10 + i);
+  }
+  left = std::move(right);
+  CHECK(right.empty() && (Contents(left) == std::vector<int>{10, 11, 12, 13, 14}));
+}
+
+TEST(IntrusiveListLinksCallerOwnedElements) {
+  std::vector<Item> items;
+  for (int i = 0; i < 6; ++i) {
+    items.emplace_back(i);
+  }
+  IntrusiveList<Item> lst;
+  for (Item& item : items) {
+    lst.push_back(item);
+  }
+  CHECK(lst.size() == 6 && &lst.front() == &items[0] && &lst.back() == &items[5]);
+
+  lst.erase(IntrusiveList<Item>::iterator_to(items[2]));
+  lst.remove(items[4]);
+  CHECK(!items[2].is_linked() && !items[4].is_linked() && items[3].is_linked());
+  lst.insert(IntrusiveList<Item>::iterator_to(items[0]), items[4]);
+  std::vector<int> values;
+  for (const Item& item : lst) {
+    values.push_back(item.value);
+  }
+  CHECK((values == std::vector<int>{4, 0, 1, 3, 5}) && lst.size() == 5);
+
+  IntrusiveList<Item> other;
+  other.push_back(items[2]);
+  lst.splice(std::next(lst.begin()), other);
+  CHECK(other.empty() && lst.size() == 6 && &*std::next(lst.begin()) == &items[2]);
+  lst.pop_front();
+  lst.pop_back();
+  CHECK(lst.size() == 4 && !items[4].is_linked() && !items[5].is_linked());
+  lst.clear();
+  CHECK(lst.empty() && !items[0].is_linked());
+}
+
+TEST(IntrusiveListTaggedHooksAutoUnlink) {
+  IntrusiveList<Person, ByAge> by_age;
+  IntrusiveList<Person, ByName> by_name;
+  Person first(1);
+  Person second(2);
+  by_age.push_back(first);
+  by_age.push_back(second);
+  by_name.push_front(first);
+  by_name.push_front(second);
+  {
+    Person third(3);
+    by_age.push_front(third);
+    by_name.push_back(third);
+    CHECK((Ids(by_age) == std::vector<int>{3, 1, 2}) && (Ids(by_name) == std::vector<int>{2, 1, 3}));
+  }
+  CHECK((Ids(by_age) == std::vector<int>{1, 2}) && (Ids(by_name) == std::vector<int>{2, 1}));
+  CHECK(by_age.size() == 2 && by_name.size() == 2);
+
+  IntrusiveList<Person, ByAge> moved(std::move(by_age));
+  CHECK(by_age.empty() && (Ids(moved) == std::vector<int>{1, 2}));
+  static_cast<IntrusiveListHook<true, ByAge>&>(second).unlink();
+  CHECK((Ids(moved) == std::vector<int>{1}) && (Ids(by_name) == std::vector<int>{2, 1}));
+}
+
+TEST(LruCacheEvictsLeastRecentlyUsed) {
+  LruCache<int, std::string> cache(3);
+  std::vector<int> evicted;
+  cache.set_eviction_callback([&](const int& key, std::string&) { evicted.push_back(key); });
+
+  cache.put(1, "one");
+  cache.put(2, "two");
+  cache.put(3, "three");
+  CHECK(cache.get(1) != nullptr);
+  cache.put(4, "four");
+  CHECK((evicted == std::vector<int>{2}));
+  CHECK(!cache.contains(2) && cache.contains(1) && cache.contains(3) && cache.contains(4));
+
+  cache.put(3, "THREE");
+  cache.put(5, "five");
+  CHECK((evicted == std::vector<int>{2, 1}));
+  CHECK(cache.get(3) != nullptr && *cache.get(3) == "THREE");
+  CHECK(cache.size() == 3);
+}
+
+TEST(LruCacheEvictsByWeight) {
+  LruCache<int, std::string> cache(100, 10, std::allocator<int>(),
+                                   [](const int&, const std::string& value) { return value.size(); });
+  cache.put(1, "aaaa");
+  cache.put(2, "bbbb");
+  CHECK(cache.bytes() == 8 && cache.size() == 2);
+  cache.put(3, "cccc");
+  CHECK(!cache.contains(1) && cache.contains(2) && cache.contains(3));
+  CHECK(cache.bytes() == 8);
+}
+
+TEST(LruCacheKeepsWeightWhenReplacementThrows) {
+  struct Payload {
+    size_t size;
+
+    Payload(size_t size, bool fail) : size(size) {
+      if (fail) {
+        throw std::runtime_error("payload");
+      }
+    }
+  };
+  LruCache<int, Payload> cache(100, 10, std::allocator<int>(), [](const int&, const Payload& value) { return value.size; });
+  cache.put(1, 4, false);
+  cache.put(2, 4, false);
+  bool threw = false;
+  try {
+    cache.put(1, 6, true);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw && cache.bytes() == 8 && cache.get(1)->size == 4);
+  cache.put(3, 4, false);
+  CHECK(cache.bytes() == 8 && !cache.contains(2) && cache.contains(1) && cache.contains(3));
+}
+
+TEST(MpscQueueKeepsPerProducerOrder) {
+  constexpr int kProducers = 4;
+  constexpr int kItems = 20000;
+  MpscQueue<std::pair<int, int>> queue;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < kProducers; ++producer) {
+    producers.emplace_back([&queue, producer] {
+      for (int i = 0; i < kItems; ++i) {
+        queue.push({producer, i});
+      }
+    });
+  }
+
+  std::vector<int> next(kProducers, 0);
+  bool ordered = true;
+  int received = 0;
+  List<std::pair<int, int>> batch;
+  while (received < kProducers * kItems) {
+    if (received % 2 == 0) {
+      if (auto item = queue.try_pop()) {
+        ordered = ordered && item->second == next[item->first]++;
+        ++received;
+      }
+      continue;
+    }
+    queue.drain(batch, 64);
+    for (const auto& [producer, i] : batch) {
+      ordered = ordered && i == next[producer]++;
+      ++received;
+    }
+    batch.clear();
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  CHECK(ordered);
+  CHECK(queue.empty());
+  for (int producer = 0; producer < kProducers; ++producer) {
+    CHECK(next[producer] == kItems);
+  }
+}
+
+int main(int argc, char** argv) {
+  return RunTests(argc, argv);
+}
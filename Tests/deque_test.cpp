@@ -0,0 +1,112 @@
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../Deque/deque.h"
+
+namespace {
+
+template <typename T>
+std::vector<T> Contents(const Deque<T>& deque) {
+  std::vector<T> values;
+  for (size_t i = 0; i < deque.size(); ++i) {
+    values.push_back(deque[i]);
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(DequeGrowsAtBothEnds) {
+  Deque<int> deque;
+  for (int i = 0; i < 100; ++i) {
+    deque.push_back(i);
+    deque.push_front(-i - 1);
+  }
+  CHECK(deque.size() == 200);
+  for (int i = 0; i < 200; ++i) {
+    CHECK(deque[i] == i - 100);
+  }
+  CHECK(*deque.begin() == -100 && *(deque.end() - 1) == 99 && deque.end() - deque.begin() == 200);
+
+  std::vector<int> reversed(deque.rbegin(), deque.rend());
+  CHECK(reversed.size() == 200 && reversed.front() == 99 && reversed.back() == -100);
+
+  for (int i = 0; i < 50; ++i) {
+    deque.pop_front();
+    deque.pop_back();
+  }
+  CHECK(deque.size() == 100 && deque[0] == -50 && deque[99] == 49);
+}
+
+TEST(DequeAtChecksBounds) {
+  Deque<int> deque(40, 7);
+  CHECK(deque.size() == 40 && deque.at(39) == 7);
+  bool threw = false;
+  try {
+    deque.at(40);
+  } catch (const std::out_of_range&) {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK(Deque<int>(5).at(4) == 0);
+}
+
+TEST(DequeInsertAndEraseMatchStdDeque) {
+  std::mt19937 rng(11);
+  Deque<std::string> deque;
+  std::deque<std::string> expected;
+  for (int step = 0; step < 2000; ++step) {
+    std::string value = std::to_string(step);
+    size_t pos = expected.empty() ? 0 : rng() % (expected.size() + 1);
+    switch (rng() % 6) {
+      case 0:
+        deque.push_back(value);
+        expected.push_back(value);
+        break;
+      case 1:
+        deque.push_front(value);
+        expected.push_front(value);
+        break;
+      case 2:
+      case 3:
+        deque.insert(deque.begin() + static_cast<int>(pos), value);
+        expected.insert(expected.begin() + pos, value);
+        break;
+      default:
+        if (!expected.empty()) {
+          pos %= expected.size();
+          deque.erase(deque.begin() + static_cast<int>(pos));
+          expected.erase(expected.begin() + pos);
+        }
+        break;
+    }
+  }
+  CHECK(Contents(deque) == std::vector<std::string>(expected.begin(), expected.end()));
+}
+
+TEST(DequeCopiesAreIndependent) {
+  Deque<std::string> original;
+  for (int i = 0; i < 70; ++i) {
+    original.push_back(std::to_string(i));
+  }
+  Deque<std::string> copy(original);
+  copy[0] = "changed";
+  copy.push_front("front");
+  CHECK(original.size() == 70 && original[0] == "0");
+  CHECK(copy.size() == 71 && copy[1] == "changed");
+
+  Deque<std::string> assigned;
+  assigned.push_back("old");
+  assigned = copy;
+  assigned = assigned;
+  CHECK(Contents(assigned) == Contents(copy));
+  assigned.pop_back();
+  CHECK(copy.size() == 71 && copy[70] == "69");
+}
+
+int main(int argc, char** argv) {
+  return RunTests(argc, argv);
+}
@@ -0,0 +1,251 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "../SharedPtr/shared_ptr.h"
+#include "../SharedPtr/epoch_domain.h"
+#include "../SharedPtr/object_pool.h"
+
+// Built once per count policy, like shared_ptr_test.
+namespace {
+
+std::atomic<long> alive{0};
+
+struct Buffer {
+  int uses = 0;
+
+  Buffer() { ++alive; }
+  ~Buffer() { --alive; }
+};
+
+struct Node {
+  int id;
+  SharedPtr<Node> next;
+
+  explicit Node(int id, SharedPtr<Node> next = SharedPtr<Node>()) : id(id), next(std::move(next)) { ++alive; }
+  ~Node() { --alive; }
+};
+
+// Both fields are always equal in a published value; a reclaimed one would break that.
+struct Pair {
+  long first;
+  long second;
+
+  explicit Pair(long value) : first(value), second(value) { ++alive; }
+  ~Pair() {
+    first = -1;
+    second = -2;
+    --alive;
+  }
+};
+
+void Settle() {
+#ifdef SHARED_PTR_BIASED_COUNT
+  BiasedCountPolicy::flush();
+#endif
+}
+
+// Collects until nothing retired is left alive, for as many rounds as epochs need to move on.
+bool CollectAll() {
+  for (int round = 0; round < 100 && alive.load() != 0; ++round) {
+    EpochDomain::collect();
+    Settle();
+  }
+  return alive.load() == 0;
+}
+
+}  // namespace
+
+TEST(ObjectPoolRecyclesReleasedObjects) {
+  {
+    int resets = 0;
+    ObjectPool<Buffer> pool(4, [&resets](Buffer& buffer) {
+      buffer.uses = 0;
+      ++resets;
+    });
+    SharedPtr<Buffer> first = pool.acquire();
+    first->uses = 5;
+    Buffer* address = first.get();
+    first.reset();
+    CHECK(resets == 1 && pool.idle() >= 1 && pool.idle() <= pool.max_size());
+
+    SharedPtr<Buffer> again = pool.acquire();
+    CHECK(again.get() == address && again->uses == 0 && alive.load() == 1);
+
+    std::vector<SharedPtr<Buffer>> many;
+    for (int i = 0; i < 10; ++i) {
+      many.push_back(pool.acquire());
+    }
+    CHECK(alive.load() == 11);
+    many.clear();
+    again.reset();
+    CHECK(alive.load() == 4 && pool.idle() == 4);
+  }
+  CHECK(alive.load() == 0);
+}
+
+TEST(ObjectPoolDeletesObjectsWhoseResetThrows) {
+  ObjectPool<Buffer> pool(4, [](Buffer& buffer) {
+    if (buffer.uses != 0) {
+      throw std::runtime_error("reset");
+    }
+  });
+  SharedPtr<Buffer> clean = pool.acquire();
+  SharedPtr<Buffer> dirty = pool.acquire();
+  dirty->uses = 1;
+  Buffer* kept = clean.get();
+  clean.reset();
+  dirty.reset();
+  CHECK(alive.load() == 1);
+  CHECK(pool.acquire().get() == kept);
+}
+
+TEST(ObjectPoolOutlivedByCheckedOutObjects) {
+  SharedPtr<Buffer> kept;
+  WeakPtr<Buffer> weak;
+  {
+    ObjectPool<Buffer> pool(8);
+    SharedPtr<Buffer> idle = pool.acquire();
+    kept = pool.acquire();
+    weak = kept;
+    idle.reset();
+    CHECK(alive.load() == 2);
+  }
+  CHECK(alive.load() == 1 && !weak.expired());
+  kept->uses = 3;
+  kept.reset();
+  CHECK(alive.load() == 0 && weak.expired());
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+TEST(ObjectPoolReleasedOnOtherThreads) {
+  {
+    ObjectPool<Buffer> pool(16);
+    std::vector<SharedPtr<Buffer>> handed;
+    for (int i = 0; i < 64; ++i) {
+      handed.push_back(pool.acquire());
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      std::vector<SharedPtr<Buffer>> share(handed.begin() + t * 16, handed.begin() + (t + 1) * 16);
+      threads.emplace_back([&pool, share = std::move(share)]() mutable {
+        share.clear();
+        for (int i = 0; i < 1000; ++i) {
+          SharedPtr<Buffer> local = pool.acquire();
+        }
+      });
+    }
+    handed.clear();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    Settle();
+    CHECK(pool.idle() <= pool.max_size() && alive.load() <= 16);
+  }
+  Settle();
+  CHECK(alive.load() == 0);
+}
+#endif
+
+TEST(EpochDomainWaitsForPinnedReaders) {
+  SharedPtr<Node> node = makeShared<Node>(1);
+  WeakPtr<Node> weak = node;
+  {
+    EpochDomain::Guard guard;
+    EpochDomain::retire(std::move(node));
+    EpochDomain::retire(new Buffer());
+    for (int i = 0; i < 5; ++i) {
+      EpochDomain::collect();
+    }
+    CHECK(!weak.expired() && alive.load() == 2 && EpochDomain::pending() == 2);
+  }
+  CHECK(CollectAll());
+  CHECK(weak.expired() && EpochDomain::pending() == 0);
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+TEST(EpochDomainReadersNeverSeeReclaimedValues) {
+  constexpr int kReaders = 3;
+  std::atomic<Pair*> published{nullptr};
+  std::atomic<bool> stop{false};
+  std::atomic<bool> torn{false};
+  SharedPtr<Pair> owner = makeShared<Pair>(0);
+  published.store(owner.get());
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; ++r) {
+    readers.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        EpochDomain::Guard guard;
+        Pair* seen = published.load(std::memory_order_acquire);
+        if (seen->first != seen->second || seen->first < 0) {
+          torn = true;
+        }
+      }
+    });
+  }
+  for (long i = 1; i <= 20000; ++i) {
+    SharedPtr<Pair> next = makeShared<Pair>(i);
+    published.store(next.get(), std::memory_order_release);
+    EpochDomain::retire(std::move(owner));
+    owner = std::move(next);
+  }
+  stop = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  CHECK(!torn.load());
+  owner.reset();
+  CHECK(CollectAll());
+}
+#endif
+
+TEST(DeferredReclaimerDrainsInSlices) {
+  {
+    DeferredReclaimer::Scope scope;
+    SharedPtr<Node> chain;
+    for (int id = 0; id < 5; ++id) {
+      chain = makeShared<Node>(id, std::move(chain));
+    }
+    chain.reset();
+    CHECK(alive.load() == 5 && DeferredReclaimer::pending() == 1);
+    CHECK(DeferredReclaimer::drain(2) == 2);
+    CHECK(alive.load() == 3 && DeferredReclaimer::pending() == 1);
+    CHECK(DeferredReclaimer::drain() == 3);
+    CHECK(alive.load() == 0 && DeferredReclaimer::pending() == 0);
+  }
+  CHECK(!DeferredReclaimer::active());
+  SharedPtr<Node> outside = makeShared<Node>(9);
+  outside.reset();
+  CHECK(alive.load() == 0);
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+TEST(DeferredReclaimerBackgroundThreadDestroys) {
+  {
+    DeferredReclaimer::Scope scope(DeferredReclaimer::Mode::Background);
+    for (int id = 0; id < 1000; ++id) {
+      SharedPtr<Node> node = makeShared<Node>(id, makeShared<Node>(-id));
+    }
+  }
+  CHECK(DeferredReclaimer::pending() == 0);
+  // Under biased counts the worker queues its releases of children back to this thread.
+  for (int i = 0; i < 500 && alive.load() != 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    Settle();
+  }
+  CHECK(alive.load() == 0);
+}
+#endif
+
+int main(int argc, char** argv) {
+  int result = RunTests(argc, argv);
+  Settle();
+  if (alive.load() != 0) {
+    std::fprintf(stderr, "%ld objects still alive\n", alive.load());
+    return 1;
+  }
+  return result;
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "../PersistentList/persistent_list.h"
+#include "../InternCache/intern_cache.h"
+
+// Built once per count policy, like shared_ptr_test.
+namespace {
+
+std::atomic<long> alive{0};
+
+struct Counted {
+  int value;
+
+  explicit Counted(int value) : value(value) { ++alive; }
+  Counted(const Counted& tmp) : value(tmp.value) { ++alive; }
+  ~Counted() { --alive; }
+};
+
+void Settle() {
+#ifdef SHARED_PTR_BIASED_COUNT
+  BiasedCountPolicy::flush();
+#endif
+}
+
+template <typename T>
+std::vector<int> Values(const PersistentList<T>& lst) {
+  std::vector<int> values;
+  for (const T& item : lst) {
+    values.push_back(item.value);
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(PersistentListVersionsShareTails) {
+  {
+    PersistentList<Counted> empty;
+    PersistentList<Counted> one = empty.emplace_front(1);
+    PersistentList<Counted> two = one.emplace_front(2);
+    PersistentList<Counted> other = one.push_front(Counted(3));
+    CHECK(empty.empty() && one.size() == 1 && two.size() == 2 && other.size() == 2);
+    CHECK((Values(two) == std::vector<int>{2, 1}) && (Values(other) == std::vector<int>{3, 1}));
+    CHECK(&*std::next(two.begin()) == &*one.begin() && &*std::next(other.begin()) == &one.front());
+    CHECK(alive.load() == 3);
+
+    PersistentList<Counted> popped = two.pop_front();
+    CHECK(&popped.front() == &one.front() && two.size() == 2 && popped.size() == 1);
+    two = PersistentList<Counted>();
+    CHECK(alive.load() == 2 && (Values(other) == std::vector<int>{3, 1}));
+  }
+  CHECK(alive.load() == 0);
+}
+
+TEST(PersistentListDropsLongChainsIteratively) {
+  {
+    PersistentList<Counted> lst;
+    for (int i = 0; i < 1000000; ++i) {
+      lst = lst.emplace_front(i);
+    }
+    PersistentList<Counted> shared_tail = lst;
+    for (int i = 0; i < 10; ++i) {
+      shared_tail = shared_tail.pop_front();
+    }
+    lst = PersistentList<Counted>();
+    CHECK(alive.load() == 1000000 - 10 && shared_tail.front().value == 1000000 - 11);
+  }
+  CHECK(alive.load() == 0);
+}
+
+TEST(InternCacheReturnsOneValuePerLiveKey) {
+  InternCache<int, std::string> cache(4);
+  SharedPtr<const std::string> first = cache.intern(1, "one");
+  SharedPtr<const std::string> again = cache.intern(1, "ignored");
+  SharedPtr<const std::string> second = cache.intern(2, 3, 'x');
+  CHECK(first.get() == again.get() && *again == "one" && *second == "xxx");
+  CHECK(cache.find(2).get() == second.get() && cache.find(3).get() == nullptr);
+
+  first.reset();
+  CHECK(cache.find(1).get() == again.get());
+  again.reset();
+  CHECK(cache.find(1).get() == nullptr);
+  SharedPtr<const std::string> rebuilt = cache.intern(1, "uno");
+  CHECK(*rebuilt == "uno" && cache.find(1).get() == rebuilt.get());
+}
+
+TEST(InternCacheSweepsDeadEntries) {
+  InternCache<int, std::string> cache(1);
+  {
+    std::vector<SharedPtr<const std::string>> held;
+    for (int key = 0; key < 1000; ++key) {
+      held.push_back(cache.intern(key, std::to_string(key)));
+    }
+    CHECK(cache.size() == 1000);
+  }
+  SharedPtr<const std::string> kept = cache.intern(-1, "kept");
+  for (int i = 0; i < 2000; ++i) {
+    cache.find(i);
+  }
+  CHECK(cache.size() < 1000 && *cache.find(-1) == "kept");
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+TEST(InternCacheAgreesAcrossThreads) {
+  constexpr int kThreads = 4;
+  constexpr int kKeys = 500;
+  InternCache<int, std::string> cache;
+  std::vector<std::vector<SharedPtr<const std::string>>> seen(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&cache, &held = seen[t]] {
+      for (int key = 0; key < kKeys; ++key) {
+        held.push_back(cache.intern(key, std::to_string(key)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  bool same = true;
+  for (int t = 1; t < kThreads; ++t) {
+    for (int key = 0; key < kKeys; ++key) {
+      same = same && seen[t][key].get() == seen[0][key].get();
+    }
+  }
+  CHECK(same && *seen[0][kKeys - 1] == std::to_string(kKeys - 1));
+  seen.clear();
+  Settle();
+}
+#endif
+
+int main(int argc, char** argv) {
+  int result = RunTests(argc, argv);
+  Settle();
+  if (alive.load() != 0) {
+    std::fprintf(stderr, "%ld objects still alive\n", alive.load());
+    return 1;
+  }
+  return result;
+}
@@ -0,0 +1,411 @@
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "../SharedPtr/shared_ptr.h"
+#include "../SharedPtr/atomic_shared_ptr.h"
+#include "../SharedPtr/compact_shared_ptr.h"
+#include "../SharedPtr/intrusive_ptr.h"
+
+// Built once per count policy (see Tests/CMakeLists.txt); the multi-threaded cases are left out of the
+// single-threaded build, whose counts are not meant to be shared between threads.
+namespace {
+
+std::atomic<long> alive{0};
+
+// Records the order in which objects are destroyed.
+class Log {
+public:
+  void add(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ids_.push_back(id);
+  }
+
+  std::vector<int> take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int> ids;
+    ids.swap(ids_);
+    return ids;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<int> ids_;
+};
+
+Log destroyed;
+
+struct Tracked {
+  int id;
+  SharedPtr<Tracked> child;
+
+  explicit Tracked(int id, SharedPtr<Tracked> child = SharedPtr<Tracked>()) : id(id), child(std::move(child)) {
+    ++alive;
+  }
+
+  ~Tracked() {
+    destroyed.add(id);
+    --alive;
+  }
+};
+
+// Both fields are always equal in a published value; a torn or freed one would break that.
+struct Pair {
+  long first;
+  long second;
+
+  explicit Pair(long value) : first(value), second(value) { ++alive; }
+  ~Pair() {
+    first = -1;
+    second = -2;
+    --alive;
+  }
+};
+
+// Default-constructible, for the array cases.
+struct Counted {
+  int value = 0;
+
+  Counted() { ++alive; }
+  Counted(const Counted& tmp) : value(tmp.value) { ++alive; }
+  ~Counted() { --alive; }
+};
+
+struct Shape: RefCounted<Shape> {
+  int id;
+
+  explicit Shape(int id) : id(id) { ++alive; }
+  ~Shape() {
+    destroyed.add(id);
+    --alive;
+  }
+};
+
+// Only the bare counter is embedded, whatever policy SharedPtr uses.
+struct Token: RefCounted<Token, NonAtomicCountPolicy> {
+  Token() { ++alive; }
+  ~Token() { --alive; }
+};
+
+// Merges counts other threads left queued on this one; a no-op unless the counts are biased.
+void Settle() {
+#ifdef SHARED_PTR_BIASED_COUNT
+  BiasedCountPolicy::flush();
+#endif
+}
+
+}  // namespace
+
+TEST(CountsFollowCopiesAndMoves) {
+  SharedPtr<Tracked> first = makeShared<Tracked>(1);
+  CHECK(first.use_count() == 1);
+  SharedPtr<Tracked> second = first;
+  CHECK(first.use_count() == 2 && second.get() == first.get());
+  SharedPtr<Tracked> third = std::move(second);
+  CHECK(first.use_count() == 2 && second.get() == nullptr && second.use_count() == 0);
+
+  WeakPtr<Tracked> weak = first;
+  CHECK(weak.use_count() == 2 && !weak.expired());
+  SharedPtr<Tracked> locked = weak.lock();
+  CHECK(locked.get() == first.get() && first.use_count() == 3);
+
+  SharedPtr<int> alias(first, &first->id);
+  CHECK(*alias == 1 && first.use_count() == 4);
+
+  first.reset();
+  third.reset();
+  locked.reset();
+  CHECK(destroyed.take().empty() && alias.use_count() == 1);
+  alias.reset();
+  CHECK((destroyed.take() == std::vector<int>{1}));
+  CHECK(weak.expired() && weak.lock().get() == nullptr);
+}
+
+TEST(LastOwnerDestroysInReleaseOrder) {
+  std::vector<SharedPtr<Tracked>> owners;
+  for (int id = 0; id < 5; ++id) {
+    owners.push_back(makeShared<Tracked>(id));
+  }
+  SharedPtr<Tracked> extra = owners[2];
+  for (int id : {3, 2, 0, 4, 1}) {
+    owners[id].reset();
+  }
+  CHECK((destroyed.take() == std::vector<int>{3, 0, 4, 1}));
+  extra.reset();
+  CHECK((destroyed.take() == std::vector<int>{2}));
+}
+
+TEST(OwnerIsDestroyedBeforeWhatItOwns) {
+  SharedPtr<Tracked> leaf = makeShared<Tracked>(3);
+  SharedPtr<Tracked> root = makeShared<Tracked>(1, makeShared<Tracked>(2, leaf));
+  leaf.reset();
+  CHECK(destroyed.take().empty());
+  root.reset();
+  CHECK((destroyed.take() == std::vector<int>{1, 2, 3}));
+}
+
+TEST(DeleterRunsOnceWhenWeakOutlivesOwners) {
+  int calls = 0;
+  WeakPtr<Tracked> weak;
+  {
+    SharedPtr<Tracked> owner(new Tracked(7), [&calls](Tracked* ptr) {
+      ++calls;
+      delete ptr;
+    });
+    SharedPtr<Tracked> copy = owner;
+    weak = copy;
+  }
+  CHECK(calls == 1);
+  CHECK((destroyed.take() == std::vector<int>{7}));
+  CHECK(weak.expired());
+}
+
+TEST(WeakPtrLockAfterExpiry) {
+  SharedPtr<Tracked> owner = makeShared<Tracked>(8);
+  WeakPtr<Tracked> weak = owner;
+  WeakPtr<Tracked> copy = weak;
+  owner.reset();
+  CHECK((destroyed.take() == std::vector<int>{8}));
+  CHECK(weak.expired() && weak.use_count() == 0 && weak.lock().get() == nullptr);
+  CHECK(copy.lock().use_count() == 0);
+  weak = copy;
+  CHECK(weak.lock().get() == nullptr && WeakPtr<Tracked>().lock().get() == nullptr);
+}
+
+TEST(ArraysDestroyEveryElement) {
+  {
+    SharedPtr<Counted[]> made = makeShared<Counted[]>(5);
+    CHECK(alive.load() == 5);
+    made[4].value = 9;
+    SharedPtr<Counted[]> copy = made;
+    made.reset();
+    CHECK(alive.load() == 5 && copy[4].value == 9 && copy.use_count() == 1);
+
+    SharedPtr<Counted[4]> bounded = makeShared<Counted[4]>();
+    SharedPtr<Counted[]> adopted(new Counted[3]);
+    CHECK(alive.load() == 12);
+    WeakPtr<Counted[]> weak = adopted;
+    adopted.reset();
+    CHECK(alive.load() == 9 && weak.expired());
+
+    SharedPtr<int[]> filled = makeShared<int[]>(3, 7);
+    CHECK(filled[0] == 7 && filled[2] == 7);
+  }
+  CHECK(alive.load() == 0);
+}
+
+TEST(IntrusivePtrSharesItsCountWithSharedPtr) {
+  IntrusivePtr<Shape> first = makeIntrusive<Shape>(20);
+  IntrusivePtr<Shape> second = first;
+  CHECK(first.use_count() == 2 && first == second);
+
+  SharedPtr<Shape> shared = first.to_shared();
+  CHECK(shared.get() == first.get() && shared.use_count() == 3);
+  WeakPtr<Shape> weak = shared;
+  first.reset();
+  second.reset();
+  CHECK(destroyed.take().empty() && shared.use_count() == 1 && !weak.expired());
+  shared.reset();
+  CHECK(weak.expired() && weak.lock().get() == nullptr);
+  // The object holds the control block, so it stays until the last WeakPtr is gone too.
+  CHECK(destroyed.take().empty());
+  weak = WeakPtr<Shape>();
+  CHECK((destroyed.take() == std::vector<int>{20}));
+  CHECK(IntrusivePtr<Shape>().to_shared().get() == nullptr);
+
+  IntrusivePtr<Token> token = makeIntrusive<Token>();
+  IntrusivePtr<Token> other = token;
+  token.reset();
+  CHECK(other.use_count() == 1 && alive.load() == 1);
+  other.reset();
+  CHECK(alive.load() == 0);
+}
+
+TEST(CompactSharedPtrSharesCountsWithSharedPtr) {
+  static_assert(sizeof(CompactSharedPtr<Tracked>) == sizeof(void*));
+  CompactSharedPtr<Tracked> compact = makeCompact<Tracked>(30);
+  CompactSharedPtr<Tracked> copy = compact;
+  CHECK(compact.use_count() == 2 && compact->id == 30 && copy == compact);
+
+  SharedPtr<Tracked> shared = compact.to_shared();
+  CHECK(shared.get() == compact.get() && shared.use_count() == 3);
+  CompactSharedPtr<Tracked> back = CompactSharedPtr<Tracked>::from_shared(shared);
+  CHECK(back.get() == compact.get() && compact.use_count() == 4);
+
+  SharedPtr<Tracked> adopted(new Tracked(31));
+  SharedPtr<Tracked> child(shared, shared->child.get());
+  CHECK(!CompactSharedPtr<Tracked>::from_shared(adopted) && !CompactSharedPtr<Tracked>::from_shared(child));
+  adopted.reset();
+  CHECK((destroyed.take() == std::vector<int>{31}));
+
+  compact.reset();
+  copy.reset();
+  shared.reset();
+  child.reset();
+  CHECK(destroyed.take().empty() && back.use_count() == 1);
+  back.reset();
+  CHECK((destroyed.take() == std::vector<int>{30}));
+}
+
+#ifndef SHARED_PTR_SINGLE_THREADED
+TEST(WeakPtrLockRacesLastRelease) {
+  constexpr int kThreads = 4;
+  for (int round = 0; round < 50; ++round) {
+    SharedPtr<Tracked> owner = makeShared<Tracked>(40);
+    WeakPtr<Tracked> weak = owner;
+    std::atomic<bool> start{false};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&] {
+        while (!start.load()) {}
+        for (int i = 0; i < 200; ++i) {
+          SharedPtr<Tracked> locked = weak.lock();
+          if (locked.get() != nullptr && locked->id != 40) {
+            torn = true;
+          }
+        }
+      });
+    }
+    start = true;
+    owner.reset();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    Settle();
+    CHECK(!torn.load() && weak.expired() && weak.lock().get() == nullptr);
+    CHECK((destroyed.take() == std::vector<int>{40}));
+  }
+}
+
+TEST(CopiesReleasedOnOtherThreads) {
+  constexpr int kThreads = 4;
+  SharedPtr<Tracked> owner = makeShared<Tracked>(11);
+  WeakPtr<Tracked> weak = owner;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([copy = owner]() mutable {
+      for (int i = 0; i < 10000; ++i) {
+        SharedPtr<Tracked> local = copy;
+        local.reset();
+      }
+      copy.reset();
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  Settle();
+  CHECK(owner.use_count() == 1);
+  owner.reset();
+  Settle();
+  CHECK((destroyed.take() == std::vector<int>{11}));
+  CHECK(weak.expired());
+}
+
+TEST(AtomicSharedPtrCompareExchangeCountsEveryWinner) {
+  constexpr int kThreads = 4;
+  constexpr int kIncrements = 5000;
+  {
+    AtomicSharedPtr<Pair> value(makeShared<Pair>(0));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&value] {
+        for (int i = 0; i < kIncrements; ++i) {
+          SharedPtr<Pair> expected = value.load();
+          while (!value.compare_exchange_strong(expected, makeShared<Pair>(expected->first + 1))) {}
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    SharedPtr<Pair> last = value.load();
+    CHECK(last->first == kThreads * kIncrements && last->second == last->first);
+  }
+  Settle();
+  CHECK(alive.load() == 0);
+}
+
+TEST(AtomicSharedPtrLoadStoreUnderContention) {
+  constexpr int kReaders = 4;
+  constexpr int kWriters = 2;
+  {
+    AtomicSharedPtr<Pair> value(makeShared<Pair>(0));
+    std::atomic<bool> stop{false};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < kReaders; ++r) {
+      threads.emplace_back([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+          SharedPtr<Pair> seen = value.load();
+          if (seen->first != seen->second || seen->first < 0) {
+            torn = true;
+          }
+        }
+      });
+    }
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w) {
+      writers.emplace_back([&value, w] {
+        for (long i = 1; i <= 20000; ++i) {
+          if (i % 2 == 0) {
+            value.store(makeShared<Pair>(i * kWriters + w));
+          } else {
+            SharedPtr<Pair> old = value.exchange(makeShared<Pair>(i * kWriters + w));
+            old.reset();
+          }
+        }
+      });
+    }
+    for (std::thread& writer : writers) {
+      writer.join();
+    }
+    stop = true;
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    CHECK(!torn.load());
+  }
+  Settle();
+  CHECK(alive.load() == 0);
+}
+#endif
+
+#ifdef SHARED_PTR_TRACK_BLOCKS
+TEST(RegistryForgetsReleasedBlocks) {
+  size_t before = ControlBlockRegistry::live();
+  {
+    std::vector<SharedPtr<Tracked>> owners;
+    for (int id = 0; id < 10; ++id) {
+      owners.push_back(makeShared<Tracked>(100 + id));
+    }
+    CHECK(ControlBlockRegistry::live() == before + 10);
+  }
+  destroyed.take();
+  CHECK(ControlBlockRegistry::live() == before);
+}
+
+TEST(RegistryForgetsRefCountedObjectsNeverShared) {
+  size_t before = ControlBlockRegistry::live();
+  {
+    Shape local(50);
+    CHECK(ControlBlockRegistry::live() == before + 1);
+    delete new Shape(51);
+  }
+  CHECK((destroyed.take() == std::vector<int>{51, 50}));
+  CHECK(ControlBlockRegistry::live() == before);
+}
+#endif
+
+int main(int argc, char** argv) {
+  int result = RunTests(argc, argv);
+  Settle();
+  if (alive.load() != 0) {
+    std::fprintf(stderr, "%ld objects still alive\n", alive.load());
+    return 1;
+  }
+  return result;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Small self-contained test runner shared by the test executables, in the spirit of Benchmarks/bench.h.
+//
+// TEST(name) { ... } registers a case; CHECK(condition) reports a failed condition and lets the case
+// carry on. RunTests runs every case whose name contains the first command-line argument, if any,
+// and returns the process exit code.
+struct TestCase {
+  const char* name;
+  void (*body)();
+};
+
+inline std::vector<TestCase>& TestCases() {
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+inline size_t& TestFailures() {
+  static size_t failures = 0;
+  return failures;
+}
+
+struct TestRegistrar {
+  TestRegistrar(const char* name, void (*body)()) {
+    TestCases().push_back(TestCase{name, body});
+  }
+};
+
+#define TEST(name)                                              \
+  static void Test_##name();                                    \
+  static TestRegistrar registrar_##name(#name, &Test_##name);   \
+  static void Test_##name()
+
+#define CHECK(condition)                                                                       \
+  do {                                                                                         \
+    if (!(condition)) {                                                                        \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);      \
+      ++TestFailures();                                                                        \
+    }                                                                                          \
+  } while (false)
+
+inline int RunTests(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : "";
+  size_t failed_cases = 0;
+  size_t run = 0;
+  for (const TestCase& test : TestCases()) {
+    if (std::strstr(test.name, filter) == nullptr) {
+      continue;
+    }
+    size_t before = TestFailures();
+    test.body();
+    ++run;
+    bool ok = TestFailures() == before;
+    failed_cases += ok ? 0 : 1;
+    std::printf("%-48s %s\n", test.name, ok ? "ok" : "FAILED");
+  }
+  std::printf("%zu of %zu cases passed\n", run - failed_cases, run);
+  return failed_cases == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#include <iterator>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "test.h"
+#include "../UnrolledList/unrolled_list.h"
+
+namespace {
+
+// Throws from its constructor when asked to, to check what a failed insertion leaves behind.
+struct Fragile {
+  int value;
+
+  explicit Fragile(int value) : value(value) {
+    if (value < 0) {
+      throw std::runtime_error("fragile");
+    }
+  }
+};
+
+template <typename T, typename Alloc, size_t N>
+std::vector<int> Values(const UnrolledList<T, Alloc, N>& lst) {
+  std::vector<int> values;
+  for (const T& item : lst) {
+    values.push_back(item.value);
+  }
+  return values;
+}
+
+// Counts the nodes a list holds, to see how full they are kept.
+size_t liveNodes = 0;
+
+template <typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t count) {
+    ++liveNodes;
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    --liveNodes;
+    std::allocator<T>().deallocate(ptr, count);
+  }
+
+  template <typename U>
+  bool operator==(const CountingAllocator<U>&) const { return true; }
+};
+
+template <typename T, typename Alloc, size_t N>
+std::vector<T> Contents(const UnrolledList<T, Alloc, N>& lst) {
+  return std::vector<T>(lst.begin(), lst.end());
+}
+
+}  // namespace
+
+TEST(UnrolledListSplitsFullNodes) {
+  UnrolledList<int, std::allocator<int>, 4> lst;
+  for (int i = 0; i < 10; ++i) {
+    lst.push_back(i);
+  }
+  auto it = lst.insert(std::next(lst.begin(), 2), 100);
+  CHECK(*it == 100 && *std::next(it) == 2);
+  it = lst.insert(std::next(lst.begin(), 4), 101);
+  CHECK(*it == 101 && *std::prev(it) == 2 && *std::next(it) == 3);
+  lst.push_front(-1);
+  CHECK((Contents(lst) == std::vector<int>{-1, 0, 1, 100, 2, 101, 3, 4, 5, 6, 7, 8, 9}));
+  CHECK(lst.size() == 13);
+  CHECK((std::vector<int>(lst.rbegin(), std::next(lst.rbegin(), 3)) == std::vector<int>{9, 8, 7}));
+}
+
+TEST(UnrolledListEraseReturnsFollowingElement) {
+  UnrolledList<int, std::allocator<int>, 4> lst;
+  for (int i = 0; i < 20; ++i) {
+    lst.push_back(i);
+  }
+  auto it = lst.begin();
+  while (it != lst.end()) {
+    it = (*it % 3 == 0 ? lst.erase(it) : std::next(it));
+  }
+  CHECK((Contents(lst) == std::vector<int>{1, 2, 4, 5, 7, 8, 10, 11, 13, 14, 16, 17, 19}));
+  lst.pop_front();
+  lst.pop_back();
+  CHECK(lst.size() == 11 && *lst.begin() == 2 && *std::prev(lst.end()) == 17);
+}
+
+TEST(UnrolledListKeepsNodesHalfFull) {
+  constexpr size_t kCapacity = 8;
+  {
+    UnrolledList<int, CountingAllocator<int>, kCapacity> lst;
+    for (int i = 0; i < 400; ++i) {
+      lst.push_back(i);
+    }
+    std::mt19937 rng(5);
+    while (lst.size() > 10) {
+      lst.erase(std::next(lst.begin(), rng() % lst.size()));
+      CHECK(liveNodes <= 2 * lst.size() / kCapacity + 1);
+    }
+  }
+  CHECK(liveNodes == 0);
+}
+
+TEST(UnrolledListMatchesStdList) {
+  std::mt19937 rng(3);
+  UnrolledList<int, std::allocator<int>, 6> lst;
+  std::list<int> expected;
+  for (int step = 0; step < 5000; ++step) {
+    size_t pos = rng() % (expected.size() + 1);
+    if (rng() % 5 < 3 || expected.empty()) {
+      lst.insert(std::next(lst.begin(), pos), step);
+      expected.insert(std::next(expected.begin(), pos), step);
+    } else {
+      pos %= expected.size();
+      lst.erase(std::next(lst.begin(), pos));
+      expected.erase(std::next(expected.begin(), pos));
+    }
+  }
+  CHECK(lst.size() == expected.size());
+  CHECK(Contents(lst) == std::vector<int>(expected.begin(), expected.end()));
+
+  UnrolledList<int, std::allocator<int>, 6> copy(lst);
+  UnrolledList<int, std::allocator<int>, 6> other;
+  other.swap(copy);
+  CHECK(copy.empty() && Contents(other) == Contents(lst));
+  other.clear();
+  CHECK(other.empty() && other.begin() == other.end());
+}
+
+TEST(UnrolledListEmplaceThatThrowsLeavesNoNode) {
+  UnrolledList<Fragile, std::allocator<Fragile>, 4> lst;
+  bool threw = false;
+  try {
+    lst.emplace_back(-1);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw && lst.empty() && lst.begin() == lst.end());
+
+  for (int i = 0; i < 4; ++i) {
+    lst.emplace_back(i);
+  }
+  threw = false;
+  try {
+    lst.emplace_back(-1);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  CHECK(threw && lst.size() == 4);
+  CHECK((Values(lst) == std::vector<int>{0, 1, 2, 3}));
+  lst.emplace_back(4);
+  CHECK((Values(lst) == std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+int main(int argc, char** argv) {
+  return RunTests(argc, argv);
+}
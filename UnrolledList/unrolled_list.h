@@ -0,0 +1,581 @@
+#pragma once
+
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+template<typename T>
+constexpr size_t UnrolledNodeCapacity() {
+  return std::max<size_t>(4, 256 / sizeof(T));
+}
+
+template<typename T, typename Alloc = std::allocator<T>, size_t N = UnrolledNodeCapacity<T>()>
+class UnrolledList {
+private:
+  static_assert(N >= 2, "UnrolledList needs at least two elements per node");
+
+  struct BaseNode {
+    BaseNode* next;
+    BaseNode* prev;
+    size_t count;
+  };
+
+  struct Node: public BaseNode {
+    alignas(T) char storage[sizeof(T) * N];
+
+    Node() : BaseNode{nullptr, nullptr, 0} {}
+  };
+
+  using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+  using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+  NodeAlloc alloc_;
+  size_t size_;
+  BaseNode fakeNode_;
+
+  static T* Slot(BaseNode* node, size_t index) {
+    return reinterpret_cast<T*>(static_cast<Node*>(node)->storage) + index;
+  }
+
+  Node* CreateNode(BaseNode* after);
+  void DestroyNode(BaseNode* node);
+  void Split(BaseNode* node);
+  void MoveRange(BaseNode* from, size_t first, size_t last, BaseNode* to, size_t at);
+  void StealRing(UnrolledList& lst) noexcept;
+  void Initialization();
+
+public:
+  using AllocTraits = std::allocator_traits<Alloc>;
+
+  template<bool is_const = false>
+  struct common_iterator {
+    using value_type = std::conditional_t<is_const, const T, T>;
+    using pointer = std::conditional_t<is_const, const T*, T*>;
+    using difference_type = int;
+    using reference = std::conditional_t<is_const, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    BaseNode* node;
+    size_t index;
+
+    common_iterator() = default;
+    common_iterator(BaseNode* tmp, size_t index) : node(tmp), index(index) {}
+    common_iterator(const BaseNode* tmp, size_t index) : node(const_cast<BaseNode*>(tmp)), index(index) {}
+
+    operator common_iterator<true>() const {
+      return common_iterator<true>(node, index);
+    }
+
+    common_iterator& operator++() {
+      if (++index == node->count) {
+        node = node->next;
+        index = 0;
+      }
+      return *this;
+    }
+
+    common_iterator& operator--() {
+      if (index == 0) {
+        node = node->prev;
+        index = node->count;
+      }
+      --index;
+      return *this;
+    }
+
+    common_iterator operator++(int) {
+      common_iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    common_iterator operator--(int) {
+      common_iterator tmp = *this;
+      --*this;
+      return tmp;
+    }
+
+    bool operator==(const common_iterator& tmp) const {
+      return node == tmp.node && index == tmp.index;
+    }
+
+    bool operator!=(const common_iterator& tmp) const {
+      return !(*this == tmp);
+    }
+
+    reference operator*() const {
+      return *Slot(node, index);
+    }
+
+    pointer operator->() const {
+      return Slot(node, index);
+    }
+  };
+
+  using iterator = common_iterator<false>;
+  using const_iterator = common_iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  UnrolledList() : size_(0) {
+    Initialization();
+  }
+
+  UnrolledList(size_t n, const T& value);
+  explicit UnrolledList(size_t n);
+  UnrolledList(const Alloc& tmp_alloc);
+  UnrolledList(size_t n, const T& value, Alloc tmp_alloc);
+  UnrolledList(const UnrolledList& lst);
+  UnrolledList(UnrolledList&& lst) noexcept;
+
+  NodeAlloc& get_allocator() {
+    return alloc_;
+  }
+
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args);
+  iterator insert(const_iterator pos, const T& value) {
+    return emplace(pos, value);
+  }
+  iterator insert(const_iterator pos, T&& value) {
+    return emplace(pos, std::move(value));
+  }
+  iterator erase(const_iterator pos);
+
+  iterator begin() {
+    return iterator(fakeNode_.next, 0);
+  }
+
+  iterator end() {
+    return iterator(&fakeNode_, 0);
+  }
+
+  const_iterator cbegin() const {
+    return const_iterator(fakeNode_.next, 0);
+  }
+
+  const_iterator cend() const {
+    return const_iterator(&fakeNode_, 0);
+  }
+
+  const_iterator begin() const {
+    return cbegin();
+  }
+
+  const_iterator end() const {
+    return cend();
+  }
+
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  const_reverse_iterator crbegin() const {
+    return const_reverse_iterator(cend());
+  }
+
+  const_reverse_iterator crend() const {
+    return const_reverse_iterator(cbegin());
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    return *emplace(end(), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  T& emplace_front(Args&&... args) {
+    return *emplace(begin(), std::forward<Args>(args)...);
+  }
+
+  void push_back(const T& value) {
+    emplace(end(), value);
+  }
+
+  void push_back(T&& value) {
+    emplace(end(), std::move(value));
+  }
+
+  void push_front(const T& value) {
+    emplace(begin(), value);
+  }
+
+  void push_front(T&& value) {
+    emplace(begin(), std::move(value));
+  }
+
+  void pop_back() {
+    erase(--end());
+  }
+
+  void pop_front() {
+    erase(begin());
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  void clear();
+  void swap(UnrolledList& lst) noexcept;
+
+  UnrolledList& operator=(const UnrolledList& lst);
+  UnrolledList& operator=(UnrolledList&& lst) noexcept(NodeAllocTraits::propagate_on_container_move_assignment::value
+                                                       || NodeAllocTraits::is_always_equal::value);
+
+  ~UnrolledList() {
+    clear();
+  }
+
+private:
+  template <typename... Args>
+  iterator Place(BaseNode* node, size_t index, Args&&... args);
+  iterator Rebalance(BaseNode* node, size_t index);
+};
+
+template<typename T, typename Alloc, size_t N>
+void swap(UnrolledList<T, Alloc, N>& left, UnrolledList<T, Alloc, N>& right) noexcept {
+  left.swap(right);
+}
+
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::Initialization() {
+  fakeNode_.next = &fakeNode_;
+  fakeNode_.prev = &fakeNode_;
+  fakeNode_.count = 0;
+}
+
+template<typename T, typename Alloc, size_t N>
+typename UnrolledList<T, Alloc, N>::Node* UnrolledList<T, Alloc, N>::CreateNode(BaseNode* after) {
+  Node* tmp = NodeAllocTraits::allocate(alloc_, 1);
+  NodeAllocTraits::construct(alloc_, tmp);
+
+  BaseNode* before = after->prev;
+  before->next = tmp;
+  after->prev = tmp;
+  tmp->next = after;
+  tmp->prev = before;
+  return tmp;
+}
+
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::DestroyNode(BaseNode* node) {
+  for (size_t i = 0; i < node->count; ++i) {
+    NodeAllocTraits::destroy(alloc_, Slot(node, i));
+  }
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  Node* tmp = static_cast<Node*>(node);
+  NodeAllocTraits::destroy(alloc_, tmp);
+  NodeAllocTraits::deallocate(alloc_, tmp, 1);
+}
+
+// Moves the upper half of a full node into a fresh node linked right after it.
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::Split(BaseNode* node) {
+  Node* tmp = CreateNode(node->next);
+  size_t half = node->count / 2;
+  try {
+    for (size_t i = half; i < node->count; ++i) {
+      NodeAllocTraits::construct(alloc_, Slot(tmp, tmp->count), std::move_if_noexcept(*Slot(node, i)));
+      ++tmp->count;
+    }
+  } catch (...) {
+    DestroyNode(tmp);
+    throw;
+  }
+  for (size_t i = half; i < node->count; ++i) {
+    NodeAllocTraits::destroy(alloc_, Slot(node, i));
+  }
+  node->count = half;
+}
+
+// Moves elements [first, last) of from to the end (at == to->count) or the front (at == 0) of to,
+// closing the gap in from. Both nodes keep their counts in step.
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::MoveRange(BaseNode* from, size_t first, size_t last, BaseNode* to, size_t at) {
+  size_t moved = last - first;
+  if (at == 0 && to->count != 0) {
+    for (size_t i = to->count; i-- > 0;) {
+      NodeAllocTraits::construct(alloc_, Slot(to, i + moved), std::move(*Slot(to, i)));
+      NodeAllocTraits::destroy(alloc_, Slot(to, i));
+    }
+  }
+  for (size_t i = 0; i < moved; ++i) {
+    NodeAllocTraits::construct(alloc_, Slot(to, at + i), std::move(*Slot(from, first + i)));
+    NodeAllocTraits::destroy(alloc_, Slot(from, first + i));
+  }
+  to->count += moved;
+  for (size_t i = last; i < from->count; ++i) {
+    NodeAllocTraits::construct(alloc_, Slot(from, i - moved), std::move(*Slot(from, i)));
+    NodeAllocTraits::destroy(alloc_, Slot(from, i));
+  }
+  from->count -= moved;
+}
+
+// Keeps every node that has a neighbour at least half full after an erase: a node that drops below
+// N / 2 merges with a neighbour when both fit in one node and otherwise borrows one element from
+// it. index is the erased position in node; the result points at the element that followed it.
+template<typename T, typename Alloc, size_t N>
+typename UnrolledList<T, Alloc, N>::iterator UnrolledList<T, Alloc, N>::Rebalance(BaseNode* node, size_t index) {
+  BaseNode* next = node->next;
+  BaseNode* prev = node->prev;
+  if (node->count < N / 2) {
+    if (next != &fakeNode_ && node->count + next->count <= N) {
+      MoveRange(next, 0, next->count, node, node->count);
+      DestroyNode(next);
+    } else if (prev != &fakeNode_ && node->count + prev->count <= N) {
+      size_t offset = prev->count;
+      MoveRange(node, 0, node->count, prev, offset);
+      DestroyNode(node);
+      node = prev;
+      index += offset;
+    } else if (next != &fakeNode_) {
+      MoveRange(next, 0, 1, node, node->count);
+    } else if (prev != &fakeNode_) {
+      MoveRange(prev, prev->count - 1, prev->count, node, 0);
+      ++index;
+    }
+  }
+  if (index == node->count) {
+    return iterator(node->next, 0);
+  }
+  return iterator(node, index);
+}
+
+template<typename T, typename Alloc, size_t N>
+template<typename... Args>
+typename UnrolledList<T, Alloc, N>::iterator UnrolledList<T, Alloc, N>::emplace(const_iterator pos, Args&&... args) {
+  BaseNode* node = pos.node;
+  size_t index = pos.index;
+  if (node == &fakeNode_) {
+    node = fakeNode_.prev;
+    if (node == &fakeNode_ || node->count == N) {
+      // The fresh tail must not outlive a throwing constructor as an empty node in the ring.
+      node = CreateNode(&fakeNode_);
+      try {
+        return Place(node, 0, std::forward<Args>(args)...);
+      } catch (...) {
+        DestroyNode(node);
+        throw;
+      }
+    }
+    index = node->count;
+  } else if (index == 0 && node->count == N && node->prev != &fakeNode_ && node->prev->count < N) {
+    node = node->prev;
+    index = node->count;
+  }
+
+  if (node->count == N) {
+    T value(std::forward<Args>(args)...);
+    Split(node);
+    if (index > node->count) {
+      index -= node->count;
+      node = node->next;
+    }
+    return Place(node, index, std::move(value));
+  }
+  return Place(node, index, std::forward<Args>(args)...);
+}
+
+template<typename T, typename Alloc, size_t N>
+template<typename... Args>
+typename UnrolledList<T, Alloc, N>::iterator UnrolledList<T, Alloc, N>::Place(BaseNode* node, size_t index, Args&&... args) {
+  if (index == node->count) {
+    NodeAllocTraits::construct(alloc_, Slot(node, index), std::forward<Args>(args)...);
+  } else {
+    T value(std::forward<Args>(args)...);
+    size_t last = node->count;
+    NodeAllocTraits::construct(alloc_, Slot(node, last), std::move(*Slot(node, last - 1)));
+    for (size_t i = last - 1; i > index; --i) {
+      *Slot(node, i) = std::move(*Slot(node, i - 1));
+    }
+    *Slot(node, index) = std::move(value);
+  }
+  ++node->count;
+  ++size_;
+  return iterator(node, index);
+}
+
+template<typename T, typename Alloc, size_t N>
+typename UnrolledList<T, Alloc, N>::iterator UnrolledList<T, Alloc, N>::erase(const_iterator pos) {
+  BaseNode* node = pos.node;
+  size_t index = pos.index;
+  for (size_t i = index; i + 1 < node->count; ++i) {
+    *Slot(node, i) = std::move(*Slot(node, i + 1));
+  }
+  --node->count;
+  NodeAllocTraits::destroy(alloc_, Slot(node, node->count));
+  --size_;
+
+  if (node->count == 0) {
+    BaseNode* next = node->next;
+    DestroyNode(node);
+    return iterator(next, 0);
+  }
+  return Rebalance(node, index);
+}
+
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::clear() {
+  while (fakeNode_.next != &fakeNode_) {
+    DestroyNode(fakeNode_.next);
+  }
+  size_ = 0;
+}
+
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::StealRing(UnrolledList& lst) noexcept {
+  if (lst.fakeNode_.next == &lst.fakeNode_) {
+    fakeNode_.next = &fakeNode_;
+    fakeNode_.prev = &fakeNode_;
+  } else {
+    fakeNode_.next = lst.fakeNode_.next;
+    fakeNode_.prev = lst.fakeNode_.prev;
+    fakeNode_.next->prev = &fakeNode_;
+    fakeNode_.prev->next = &fakeNode_;
+  }
+  fakeNode_.count = 0;
+  size_ = lst.size_;
+  lst.Initialization();
+  lst.size_ = 0;
+}
+
+template<typename T, typename Alloc, size_t N>
+void UnrolledList<T, Alloc, N>::swap(UnrolledList& lst) noexcept {
+  if (this == &lst) {
+    return;
+  }
+  if constexpr (NodeAllocTraits::propagate_on_container_swap::value) {
+    std::swap(alloc_, lst.alloc_);
+  }
+  BaseNode* first = fakeNode_.next;
+  BaseNode* last = fakeNode_.prev;
+  size_t count = size_;
+  StealRing(lst);
+  if (first != &fakeNode_) {
+    lst.fakeNode_.next = first;
+    lst.fakeNode_.prev = last;
+    first->prev = &lst.fakeNode_;
+    last->next = &lst.fakeNode_;
+  }
+  lst.size_ = count;
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>& UnrolledList<T, Alloc, N>::operator=(const UnrolledList& lst) {
+  if (this == &lst) {
+    return *this;
+  }
+  clear();
+  if constexpr (NodeAllocTraits::propagate_on_container_copy_assignment::value) {
+    alloc_ = lst.alloc_;
+  }
+  for (const T& value : lst) {
+    emplace_back(value);
+  }
+  return *this;
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>& UnrolledList<T, Alloc, N>::operator=(UnrolledList&& lst)
+    noexcept(NodeAllocTraits::propagate_on_container_move_assignment::value
+             || NodeAllocTraits::is_always_equal::value) {
+  if (this == &lst) {
+    return *this;
+  }
+  clear();
+  if constexpr (NodeAllocTraits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(lst.alloc_);
+    StealRing(lst);
+  } else {
+    if (alloc_ == lst.alloc_) {
+      StealRing(lst);
+      return *this;
+    }
+    for (T& value : lst) {
+      emplace_back(std::move(value));
+    }
+    lst.clear();
+  }
+  return *this;
+}
+
+//constructors
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(const Alloc& tmp_alloc) : alloc_(NodeAllocTraits::select_on_container_copy_construction(tmp_alloc)), size_(0) {
+  Initialization();
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(size_t n, const T& value) : size_(0) {
+  Initialization();
+  try {
+    for (size_t i = 0; i < n; ++i) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(size_t n) : size_(0) {
+  Initialization();
+  try {
+    for (size_t i = 0; i < n; ++i) {
+      emplace_back();
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(size_t n, const T& value, Alloc tmp_alloc) : alloc_(NodeAllocTraits::select_on_container_copy_construction(tmp_alloc)), size_(0) {
+  Initialization();
+  try {
+    for (size_t i = 0; i < n; ++i) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(const UnrolledList& lst) : alloc_(NodeAllocTraits::select_on_container_copy_construction(lst.alloc_)), size_(0) {
+  Initialization();
+  try {
+    for (const T& value : lst) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template<typename T, typename Alloc, size_t N>
+UnrolledList<T, Alloc, N>::UnrolledList(UnrolledList&& lst) noexcept : alloc_(std::move(lst.alloc_)), size_(0) {
+  StealRing(lst);
+}